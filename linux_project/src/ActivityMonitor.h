@@ -0,0 +1,113 @@
+#ifndef ACTIVITYMONITOR_H
+#define ACTIVITYMONITOR_H
+
+#include "opencv/cv.h"
+#include "Logger.h"
+#include <sstream>
+#include <stdlib.h>
+
+using namespace cv;
+
+const int ACTIVE_TICK = 333; // Milliseconds between two ticks while something happens
+const int IDLE_TICK = 1000; // Milliseconds between two motion checks while idle
+const int IDLE_AFTER = 60000; // Milliseconds without motion or state changes before going idle
+const int MOTION_STEP = 8; // Only every MOTION_STEP'th pixel in both directions is compared
+const int MOTION_PIXEL_DIFF = 25; // A sample changed when it differs more than this
+const double MOTION_FRACTION = 0.01; // Motion when more than this fraction of the samples changed
+const int DUTY_REPORT_INTERVAL = 60000; // Milliseconds between two duty cycle reports
+
+// Decides how often the detectors run. While the scene is static and the machine is off
+// (most of the time), the handler only compares a few pixels of the top frame with the
+// previous check, once per IDLE_TICK. Motion or a change of the status makes it active
+// again, and the detectors run every ACTIVE_TICK.
+//
+// The duty cycle is the time the detectors ran at the active rate, relative to the time
+// passed. It's reported every DUTY_REPORT_INTERVAL.
+class ActivityMonitor{
+public:
+	ActivityMonitor() : idle(false), staticfor(0), windowtime(0), activetime(0) {
+	}
+
+	bool isIdle() const {
+		return idle;
+	}
+
+	// Milliseconds until the next tick
+	int tickInterval() const {
+		return idle? IDLE_TICK : ACTIVE_TICK;
+	}
+
+	// Compare the frame with the one of the previous check. Returns true when the scene moved.
+	bool motion(const Mat& frame){
+		int rows = frame.rows / MOTION_STEP;
+		int cols = frame.cols / MOTION_STEP;
+		int step = MOTION_STEP * frame.channels();
+
+		bool first = samples.rows != rows || samples.cols != cols;
+		if(first){
+			samples.create(rows, cols, CV_8UC1);
+		}
+
+		// Only the first channel is sampled, in place
+		int changed = 0;
+		for(int y = 0; y < rows; y++){
+			const uchar* in = frame.ptr<uchar>(y * MOTION_STEP);
+			uchar* previous = samples.ptr<uchar>(y);
+			for(int x = 0; x < cols; x++){
+				uchar value = in[x * step];
+				changed += abs(value - previous[x]) > MOTION_PIXEL_DIFF;
+				previous[x] = value;
+			}
+		}
+		return first || changed > rows * cols * MOTION_FRACTION;
+	}
+
+	// Called every tick. activity tells whether something happened since the previous tick,
+	// quiet whether the machine can go idle. Returns true when the monitor became idle or active.
+	bool update(bool activity, bool quiet, int elapsed){
+		windowtime += elapsed;
+		if(!idle){
+			activetime += elapsed;
+		}
+
+		bool wasidle = idle;
+		if(activity || !quiet){
+			staticfor = 0;
+			idle = false;
+		} else {
+			staticfor += elapsed;
+			idle = staticfor >= IDLE_AFTER;
+		}
+
+		if(idle != wasidle){
+			if(idle){
+				Logger::v("The scene is static and the machine is off, only checking for motion.");
+			} else {
+				Logger::v("Activity detected, running the detectors.");
+			}
+		}
+
+		if(windowtime >= DUTY_REPORT_INTERVAL){
+			stringstream message;
+			message << "Duty cycle: " << (int)(dutyCycle() * 100 + 0.5) << "% (" << (idle? "idle" : "active") << ", tick every " << tickInterval() << " ms)";
+			Logger::v(message.str());
+			windowtime = 0;
+			activetime = 0;
+		}
+		return idle != wasidle;
+	}
+
+	// Part of the time since the last report the detectors ran at the active rate (0 to 1)
+	double dutyCycle() const {
+		return (windowtime == 0)? 0.0 : (double)activetime / windowtime;
+	}
+
+private:
+	bool idle;
+	int staticfor; // Milliseconds without activity
+	long windowtime; // Milliseconds since the last report
+	long activetime; // Milliseconds of those which were active
+	Mat samples; // Samples of the previous check
+};
+
+#endif
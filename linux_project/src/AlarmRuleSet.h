@@ -0,0 +1,340 @@
+#ifndef ALARMRULESET_H
+#define ALARMRULESET_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include "StatusField.h"
+
+using namespace std;
+
+// The built-in alarm rules, checked while the machine is brewing. The same syntax
+// is used in the rule files, see AlarmRuleSet::parse.
+static const char* default_alarm_rules =
+	"machineon && machinerunning && !hascoffeecan -> alarm coffeecan: The coffeecan needs to be inside the machine!\n"
+	"machineon && machinerunning && !hasfilter -> alarm filter: There is no coffee filter inside the coffee filter holder!\n"
+	"machineon && machinerunning && !hascoffee -> alarm coffee: There is no coffee inside the machine!\n"
+	"machineon && machinerunning && reservoiropen -> alarm reservoir: The water reservoir is still opened!\n"
+	"machineon && machinerunning && coffeefilterholder -> alarm filterholder: The coffee filter holder is outside of the machine!\n"
+	"machineon && machinerunning && !haswater -> alarm water: There is not enough water in the machine!\n";
+
+// One conjunction of a compiled condition. The term matches a state (a mask with the
+// bit of every StatusField that is true) when (state & care) == want: care contains
+// the fields the term looks at, want the value they should have.
+struct RuleTerm {
+	unsigned int care;
+	unsigned int want;
+};
+
+// An alarm rule describes a combination of states that is not allowed. The alarm
+// is active as long as one of its terms matches.
+struct AlarmRule {
+	string name;
+	string message;
+	string condition; // The condition as it was written
+	unsigned int fields; // Mask with the fields the condition reads
+	int first_term; // Index of the first term in the term list of the rule set
+	int term_count;
+};
+
+// A set of alarm rules, compiled from text. Every line contains one rule:
+//
+//     <condition> -> alarm [name][: message]
+//
+// The condition uses the names of the StatusFields combined with !, &&, || and
+// parentheses, e.g. "machineon && machinerunning && !hascoffeecan". Lines starting
+// with # are comments.
+//
+// At load time each condition is rewritten as an OR of AND-terms and every term is
+// compiled into two bit masks, so evaluating a rule costs an AND and a compare per
+// term. For every field a list of the rules reading it is kept, so only those rules
+// have to be evaluated when the field changes. A rule set never changes after it's
+// loaded and can be shared by the status of several machines.
+class AlarmRuleSet{
+public:
+	// Returns the built-in rule set
+	static shared_ptr<const AlarmRuleSet> defaults(){
+		static shared_ptr<const AlarmRuleSet> rules = compileDefaults();
+		return rules;
+	}
+
+	// Load the rules from a file. Returns false and sets error when the file is invalid.
+	static shared_ptr<const AlarmRuleSet> load(const string& path, string& error){
+		ifstream file(path.c_str());
+		if(!file.is_open()){
+			error = "Unable to open " + path;
+			return shared_ptr<const AlarmRuleSet>();
+		}
+
+		stringstream text;
+		text << file.rdbuf();
+
+		shared_ptr<AlarmRuleSet> rules(new AlarmRuleSet());
+		if(!rules->parse(text.str(), error)){
+			error = path + ": " + error;
+			return shared_ptr<const AlarmRuleSet>();
+		}
+		return rules;
+	}
+
+	// Add the rules in the text to the set. Returns false and sets error when a line is invalid.
+	bool parse(const string& text, string& error){
+		stringstream lines(text);
+		string line;
+		int number = 0;
+		while(getline(lines, line)){
+			number++;
+			if(!parseLine(line, error)){
+				stringstream message;
+				message << "line " << number << ": " << error;
+				error = message.str();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	int size() const {
+		return rules.size();
+	}
+
+	const AlarmRule& rule(int index) const {
+		return rules[index];
+	}
+
+	// Returns true when the condition of the rule matches the state
+	bool evaluate(int index, unsigned int state) const {
+		const AlarmRule& r = rules[index];
+		const RuleTerm* term = &terms[r.first_term];
+		for(int i = 0; i < r.term_count; i++, term++){
+			if((state & term->care) == term->want){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns the rules which read the field
+	const vector<int>& dependents(int field) const {
+		return dependent_rules[field];
+	}
+
+private:
+	vector<AlarmRule> rules;
+	vector<RuleTerm> terms;
+	vector<int> dependent_rules[FIELD_COUNT];
+
+	typedef vector<RuleTerm> Condition; // OR of terms, an empty condition is always false
+
+	static shared_ptr<const AlarmRuleSet> compileDefaults(){
+		shared_ptr<AlarmRuleSet> rules(new AlarmRuleSet());
+		string error;
+		rules->parse(default_alarm_rules, error);
+		return rules;
+	}
+
+	static string trim(const string& text){
+		size_t begin = text.find_first_not_of(" \t\r\n");
+		if(begin == string::npos){
+			return "";
+		}
+		size_t end = text.find_last_not_of(" \t\r\n");
+		return text.substr(begin, end - begin + 1);
+	}
+
+	bool parseLine(const string& line, string& error){
+		string text = trim(line);
+		if(text.empty() || text[0] == '#'){
+			return true;
+		}
+
+		size_t arrow = text.find("->");
+		if(arrow == string::npos){
+			error = "missing '->'";
+			return false;
+		}
+
+		AlarmRule rule;
+		rule.condition = trim(text.substr(0, arrow));
+
+		// The action: alarm [name][: message]
+		string action = trim(text.substr(arrow + 2));
+		if(action.compare(0, 5, "alarm") != 0 || (action.size() > 5 && action[5] != ' ' && action[5] != ':')){
+			error = "unknown action '" + action + "', only 'alarm' is supported";
+			return false;
+		}
+		action = action.substr(5);
+		size_t colon = action.find(':');
+		rule.name = trim(action.substr(0, colon));
+		rule.message = (colon == string::npos)? "" : trim(action.substr(colon + 1));
+		if(rule.name.empty()){
+			stringstream name;
+			name << "rule" << rules.size() + 1;
+			rule.name = name.str();
+		}
+		if(rule.message.empty()){
+			rule.message = rule.condition;
+		}
+
+		// Compile the condition
+		size_t position = 0;
+		Condition condition;
+		if(!parseOr(rule.condition, position, condition, error)){
+			return false;
+		}
+		skipSpaces(rule.condition, position);
+		if(position != rule.condition.size()){
+			error = "unexpected '" + rule.condition.substr(position) + "'";
+			return false;
+		}
+
+		rule.fields = 0;
+		rule.first_term = terms.size();
+		rule.term_count = condition.size();
+		for(int i = 0; i < condition.size(); i++){
+			rule.fields |= condition[i].care;
+			terms.push_back(condition[i]);
+		}
+
+		for(int field = 0; field < FIELD_COUNT; field++){
+			if(rule.fields & fieldBit(field)){
+				dependent_rules[field].push_back(rules.size());
+			}
+		}
+		rules.push_back(rule);
+		return true;
+	}
+
+	static void skipSpaces(const string& text, size_t& position){
+		while(position < text.size() && (text[position] == ' ' || text[position] == '\t')){
+			position++;
+		}
+	}
+
+	static bool accept(const string& text, size_t& position, const char* token){
+		skipSpaces(text, position);
+		size_t length = string(token).size();
+		if(text.compare(position, length, token) == 0){
+			position += length;
+			return true;
+		}
+		return false;
+	}
+
+	// or := and ('||' and)*
+	static bool parseOr(const string& text, size_t& position, Condition& result, string& error){
+		if(!parseAnd(text, position, result, error)){
+			return false;
+		}
+		while(accept(text, position, "||")){
+			Condition right;
+			if(!parseAnd(text, position, right, error)){
+				return false;
+			}
+			result.insert(result.end(), right.begin(), right.end());
+		}
+		return true;
+	}
+
+	// and := unary ('&&' unary)*
+	static bool parseAnd(const string& text, size_t& position, Condition& result, string& error){
+		if(!parseUnary(text, position, result, error)){
+			return false;
+		}
+		while(accept(text, position, "&&")){
+			Condition right;
+			if(!parseUnary(text, position, right, error)){
+				return false;
+			}
+			result = conjunction(result, right);
+		}
+		return true;
+	}
+
+	// unary := '!' unary | '(' or ')' | field
+	static bool parseUnary(const string& text, size_t& position, Condition& result, string& error){
+		if(accept(text, position, "!")){
+			Condition operand;
+			if(!parseUnary(text, position, operand, error)){
+				return false;
+			}
+			result = negation(operand);
+			return true;
+		}
+
+		if(accept(text, position, "(")){
+			if(!parseOr(text, position, result, error)){
+				return false;
+			}
+			if(!accept(text, position, ")")){
+				error = "missing ')'";
+				return false;
+			}
+			return true;
+		}
+
+		skipSpaces(text, position);
+		size_t begin = position;
+		while(position < text.size() && (isalnum(text[position]) || text[position] == '_')){
+			position++;
+		}
+		string name = text.substr(begin, position - begin);
+		int field = statusFieldFromName(name);
+		if(field < 0){
+			error = name.empty()? "expected a field name" : "unknown field '" + name + "'";
+			return false;
+		}
+
+		RuleTerm term;
+		term.care = fieldBit(field);
+		term.want = fieldBit(field);
+		result = Condition(1, term);
+		return true;
+	}
+
+	// (a1 || a2) && (b1 || b2) = a1&&b1 || a1&&b2 || a2&&b1 || a2&&b2
+	static Condition conjunction(const Condition& left, const Condition& right){
+		Condition result;
+		for(int i = 0; i < left.size(); i++){
+			for(int j = 0; j < right.size(); j++){
+				// Terms that need a field to be true and false at the same time can never match
+				if((left[i].want ^ right[j].want) & left[i].care & right[j].care){
+					continue;
+				}
+				RuleTerm term;
+				term.care = left[i].care | right[j].care;
+				term.want = left[i].want | right[j].want;
+				result.push_back(term);
+			}
+		}
+		return result;
+	}
+
+	// !(t1 || t2) = !t1 && !t2, and !(a && !b) = !a || b
+	static Condition negation(const Condition& condition){
+		RuleTerm always;
+		always.care = 0;
+		always.want = 0;
+		Condition result(1, always);
+
+		for(int i = 0; i < condition.size(); i++){
+			Condition negated;
+			for(int field = 0; field < FIELD_COUNT; field++){
+				unsigned int bit = fieldBit(field);
+				if(condition[i].care & bit){
+					RuleTerm term;
+					term.care = bit;
+					term.want = (condition[i].want & bit)? 0 : bit;
+					negated.push_back(term);
+				}
+			}
+			result = conjunction(result, negated);
+		}
+		return result;
+	}
+};
+
+#endif
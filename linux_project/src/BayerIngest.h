@@ -0,0 +1,61 @@
+#ifndef BAYER_INGEST_H
+#define BAYER_INGEST_H
+
+#include "opencv/cv.h"
+
+using namespace cv;
+
+// Converts the raw Bayer frames of the camera's to color frames.
+//
+// The camera's deliver the Bayer mosaic in the first channel of the frame. The full
+// resolution conversion (CV_BayerRG2RGB) interpolates the missing colors of every
+// pixel, while the detectors mostly work at half resolution. halfResolution turns
+// every 2x2 quad of the mosaic directly into one color pixel instead: the red and blue
+// values are taken as they are and the two green values are averaged. That skips the
+// interpolation, and every frame downstream is a quarter of the size.
+class BayerIngest{
+public:
+	// Full resolution conversion, the original ingest path
+	static void fullResolution(const Mat& raw, Mat& rgb){
+		cvtColor(mosaic(raw), rgb, CV_BayerRG2RGB);
+	}
+
+	// Half resolution conversion, one color pixel per 2x2 quad of the mosaic.
+	// The channels are in the same order as the result of fullResolution.
+	static void halfResolution(const Mat& raw, Mat& rgb){
+		int rows = raw.rows / 2;
+		int cols = raw.cols / 2;
+		int step = raw.channels(); // Distance between two pixels of the mosaic
+		rgb.create(rows, cols, CV_8UC3);
+
+		for(int y = 0; y < rows; y++){
+			// The channel 0 values are read in place, so the frame doesn't have to be split
+			const uchar* top = raw.ptr<uchar>(2 * y);
+			const uchar* bottom = raw.ptr<uchar>(2 * y + 1);
+			uchar* out = rgb.ptr<uchar>(y);
+
+			// Simple loop without branches, so the compiler can vectorize it
+			for(int x = 0; x < cols; x++){
+				int left = 2 * x * step;
+				int right = left + step;
+				out[3 * x] = bottom[right];
+				out[3 * x + 1] = (uchar)((top[right] + bottom[left] + 1) >> 1);
+				out[3 * x + 2] = top[left];
+			}
+		}
+	}
+
+private:
+	// Returns the channel with the mosaic. Frames with one channel are returned as they are.
+	static Mat mosaic(const Mat& raw){
+		if(raw.channels() == 1){
+			return raw;
+		}
+		Mat channel(raw.rows, raw.cols, CV_8UC1);
+		int from_to[] = { 0, 0 };
+		mixChannels(&raw, 1, &channel, 1, from_to, 1);
+		return channel;
+	}
+};
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include "opencv/cv.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+const int BITMASK_MAX_SIZE = 15; // Largest window supported by the median filter
+
+// Binary mask with one bit per pixel, used for the result of the color filters
+// (see Helper::filterColor, only with USE_BITMASK_FILTER).
+//
+// Every row is stored in 64-bit words, pixel x of a row is bit x % 64 of word x / 64.
+// The median filter processes a whole word (64 pixels) with a few bitwise operations:
+// a neighbour of all 64 pixels is just the word shifted by one or more bits, and the
+// neighbours are counted with bit-sliced counters (one word per bit of the counter),
+// so the count of 64 pixels is updated at the same time. Packing and unpacking an
+// 8-bit mask handle 8 pixels per 64-bit operation (SWAR), which assumes a little
+// endian processor.
+//
+// Pixels outside of the mask are background for the median filter, where medianBlur
+// repeats the border pixels.
+class BitMask{
+public:
+	BitMask() : rows(0), cols(0), words(0) {
+	}
+
+	BitMask(int rows, int cols) {
+		create(rows, cols);
+	}
+
+	// Resize the mask, all pixels are cleared
+	void create(int r, int c){
+		rows = r;
+		cols = c;
+		words = (c + 63) / 64;
+		bits.assign((size_t)rows * words, 0);
+	}
+
+	int getRows() const { return rows; }
+	int getCols() const { return cols; }
+
+	bool get(int y, int x) const {
+		return (row(y)[x >> 6] >> (x & 63)) & 1;
+	}
+
+	void set(int y, int x, bool value){
+		uint64_t bit = (uint64_t)1 << (x & 63);
+		if(value){
+			row(y)[x >> 6] |= bit;
+		} else {
+			row(y)[x >> 6] &= ~bit;
+		}
+	}
+
+	// Number of pixels that are set
+	int count() const {
+		int total = 0;
+		for(size_t i = 0; i < bits.size(); i++){
+			total += __builtin_popcountll(bits[i]);
+		}
+		return total;
+	}
+
+	// Set the pixels of a 3-channel frame which are inside the range. The compare is done
+	// by the vectorized inRange of OpenCV, the result is packed.
+	void inRange(const Mat& frame, const Scalar& lower, const Scalar& upper){
+		Mat mask;
+		cv::inRange(frame, lower, upper, mask);
+		pack(mask);
+	}
+
+	// Set the pixels which are not 0 in an 8-bit mask
+	void pack(const Mat& mask){
+		create(mask.rows, mask.cols);
+		for(int y = 0; y < rows; y++){
+			const uchar* p = mask.ptr<uchar>(y);
+			uint64_t* out = row(y);
+			int x = 0;
+			for(; x + 8 <= cols; x += 8){
+				uint64_t bytes;
+				memcpy(&bytes, p + x, 8);
+				// Bit 0 of every byte becomes the OR of the bits of that byte
+				bytes |= bytes >> 4;
+				bytes |= bytes >> 2;
+				bytes |= bytes >> 1;
+				bytes &= 0x0101010101010101ULL;
+				// Gather bit 0 of the 8 bytes in the top byte
+				out[x >> 6] |= ((bytes * 0x0102040810204080ULL) >> 56) << (x & 63);
+			}
+			for(; x < cols; x++){
+				out[x >> 6] |= (uint64_t)(p[x] != 0) << (x & 63);
+			}
+		}
+	}
+
+	// Convert to an 8-bit mask (0 or 255), as used by Canny, findContours, ...
+	void unpack(Mat& mask) const {
+		mask.create(rows, cols, CV_8UC1);
+		for(int y = 0; y < rows; y++){
+			const uint64_t* in = row(y);
+			uchar* p = mask.ptr<uchar>(y);
+			int x = 0;
+			for(; x + 8 <= cols; x += 8){
+				uint64_t bits = (in[x >> 6] >> (x & 63)) & 0xFF;
+				// Byte k keeps bit k, then every byte which isn't 0 becomes 0xFF
+				uint64_t bytes = (bits * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+				bytes = ((bytes + 0x7F7F7F7F7F7F7F7FULL) & 0x8080808080808080ULL) >> 7;
+				bytes *= 0xFF;
+				memcpy(p + x, &bytes, 8);
+			}
+			for(; x < cols; x++){
+				p[x] = (uchar)(0 - ((in[x >> 6] >> (x & 63)) & 1));
+			}
+		}
+	}
+
+	// Median filter with a square window of the given (odd) size: a pixel is set when
+	// more than half of the pixels in the window are set.
+	void median(int size, BitMask& result) const {
+		int radius = min(size, BITMASK_MAX_SIZE) / 2;
+		int total = (2 * radius + 1) * (2 * radius + 1);
+		int majority = total / 2 + 1;
+
+		int planes = 0;
+		while((1 << planes) <= total){
+			planes++;
+		}
+
+		result.create(rows, cols);
+		for(int y = 0; y < rows; y++){
+			uint64_t* out = result.row(y);
+			for(int w = 0; w < words; w++){
+				// Add every pixel of the window to the bit-sliced counters
+				uint64_t counter[8] = { 0 };
+				for(int dy = -radius; dy <= radius; dy++){
+					const uint64_t* in = rowOrNull(y + dy);
+					if(in == 0){
+						continue;
+					}
+					for(int dx = -radius; dx <= radius; dx++){
+						uint64_t carry = neighbour(in, w, dx);
+						for(int p = 0; p < planes && carry != 0; p++){
+							uint64_t next = counter[p] & carry;
+							counter[p] ^= carry;
+							carry = next;
+						}
+					}
+				}
+				out[w] = atLeast(counter, planes, majority) & tail(w);
+			}
+		}
+	}
+
+private:
+	int rows, cols;
+	int words; // Words per row
+	vector<uint64_t> bits;
+
+	uint64_t* row(int y){
+		return &bits[(size_t)y * words];
+	}
+
+	const uint64_t* row(int y) const {
+		return &bits[(size_t)y * words];
+	}
+
+	const uint64_t* rowOrNull(int y) const {
+		return (y < 0 || y >= rows)? 0 : row(y);
+	}
+
+	// Bits of the last word which are outside of the mask are always 0
+	uint64_t tail(int w) const {
+		int used = cols - w * 64;
+		return (used >= 64)? ~(uint64_t)0 : (((uint64_t)1 << used) - 1);
+	}
+
+	// Word w of the row, shifted so every bit holds the pixel dx to the right of it
+	uint64_t neighbour(const uint64_t* in, int w, int dx) const {
+		if(dx > 0){
+			uint64_t next = (w + 1 < words)? in[w + 1] : 0;
+			return (in[w] >> dx) | (next << (64 - dx));
+		} else if(dx < 0){
+			uint64_t previous = (w > 0)? in[w - 1] : 0;
+			return (in[w] << -dx) | (previous >> (64 + dx));
+		}
+		return in[w];
+	}
+
+	// Bits of which the bit-sliced counter is at least the given value
+	static uint64_t atLeast(const uint64_t* counter, int planes, int value){
+		uint64_t greater = 0;
+		uint64_t equal = ~(uint64_t)0;
+		for(int p = planes - 1; p >= 0; p--){
+			if((value >> p) & 1){
+				equal &= counter[p];
+			} else {
+				greater |= equal & counter[p];
+				equal &= ~counter[p];
+			}
+		}
+		return greater | equal;
+	}
+};
+
+#endif
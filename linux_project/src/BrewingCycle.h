@@ -0,0 +1,163 @@
+#ifndef BREWINGCYCLE_H
+#define BREWINGCYCLE_H
+
+#include "StatusField.h"
+#include "StatusSnapshot.h"
+#include "Logger.h"
+#include <string>
+
+// The stages of making coffee, in the order they normally happen
+enum BrewingStage {
+	STAGE_IDLE = 0, // Nothing is happening
+	STAGE_RESERVOIROPEN, // The water reservoir was opened
+	STAGE_FILLING, // Water is put in the reservoir
+	STAGE_FILTER, // The reservoir is closed, waiting for a filter in the holder
+	STAGE_COFFEE, // The filter is in the holder, waiting for coffee
+	STAGE_HOLDERIN, // There is coffee in the filter, waiting for the holder to go back in
+	STAGE_ON, // The holder is back in, waiting for the machine to be turned on
+	STAGE_BREWING, // The machine is on and making coffee
+	STAGE_DONE, // The machine stopped running
+	STAGE_COUNT
+};
+
+// Moves to the next stage when a field of the status changes to the given value
+struct BrewingTransition {
+	StatusField field;
+	bool value;
+	BrewingStage next;
+};
+
+const int MAX_BREWING_TRANSITIONS = 3;
+const int STAGE_TIMEOUT = 600000; // Milliseconds without a change after which a stage of the preparation is abandoned
+const int BREWING_TIMEOUT = 1800000; // The same for brewing and done, longer than making a pot takes
+
+// A stage, the detectors which run during it (bit of the field they detect) and the changes
+// which end it. Only the detectors which can end the stage run, and the coffee can and
+// reservoir detectors while the machine can be brewing, because the alarms need them.
+// The machine can be turned on during every step of the preparation, a skipped step is
+// then reported by the alarms. A stage with a timeout goes back to idle when none of its
+// fields changed for that many milliseconds (0 for never).
+struct BrewingStageInfo {
+	const char* name;
+	unsigned int detectors;
+	int timeout;
+	int count;
+	BrewingTransition transitions[MAX_BREWING_TRANSITIONS];
+};
+
+static const BrewingStageInfo brewing_stages[STAGE_COUNT] = {
+	{ "idle", fieldBit(FIELD_RESERVOIROPEN) | fieldBit(FIELD_COFFEEFILTERHOLDER) | fieldBit(FIELD_MACHINEON) | fieldBit(FIELD_HASCOFFEECAN), 0, 3, {
+		{ FIELD_RESERVOIROPEN, true, STAGE_RESERVOIROPEN },
+		{ FIELD_COFFEEFILTERHOLDER, true, STAGE_FILTER }, // The water was already filled
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } }, // Everything was already prepared
+	{ "reservoir open", fieldBit(FIELD_RESERVOIROPEN) | fieldBit(FIELD_HASWATER) | fieldBit(FIELD_MACHINEON), STAGE_TIMEOUT, 3, {
+		{ FIELD_HASWATER, true, STAGE_FILLING },
+		{ FIELD_RESERVOIROPEN, false, STAGE_IDLE },
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } },
+	{ "filling", fieldBit(FIELD_RESERVOIROPEN) | fieldBit(FIELD_HASWATER) | fieldBit(FIELD_MACHINEON), STAGE_TIMEOUT, 2, {
+		{ FIELD_RESERVOIROPEN, false, STAGE_FILTER },
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } },
+	{ "filter", fieldBit(FIELD_COFFEEFILTERHOLDER) | fieldBit(FIELD_HASFILTER) | fieldBit(FIELD_MACHINEON), STAGE_TIMEOUT, 2, {
+		{ FIELD_HASFILTER, true, STAGE_COFFEE },
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } },
+	{ "coffee", fieldBit(FIELD_COFFEEFILTERHOLDER) | fieldBit(FIELD_HASCOFFEE) | fieldBit(FIELD_MACHINEON), STAGE_TIMEOUT, 3, {
+		{ FIELD_HASCOFFEE, true, STAGE_HOLDERIN },
+		{ FIELD_COFFEEFILTERHOLDER, false, STAGE_ON }, // Put back without coffee, the alarms report it
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } },
+	{ "holder in", fieldBit(FIELD_COFFEEFILTERHOLDER) | fieldBit(FIELD_MACHINEON), STAGE_TIMEOUT, 2, {
+		{ FIELD_COFFEEFILTERHOLDER, false, STAGE_ON },
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } },
+	{ "on", fieldBit(FIELD_MACHINEON) | fieldBit(FIELD_MACHINERUNNING) | fieldBit(FIELD_HASCOFFEECAN), STAGE_TIMEOUT, 1, {
+		{ FIELD_MACHINEON, true, STAGE_BREWING } } },
+	// The reservoir is watched while brewing, opening it then is dangerous
+	{ "brewing", fieldBit(FIELD_MACHINEON) | fieldBit(FIELD_MACHINERUNNING) | fieldBit(FIELD_HASCOFFEECAN) | fieldBit(FIELD_RESERVOIROPEN), BREWING_TIMEOUT, 2, {
+		{ FIELD_MACHINERUNNING, false, STAGE_DONE },
+		{ FIELD_MACHINEON, false, STAGE_IDLE } } }, // Turned off, nothing is left to wait for
+	{ "done", fieldBit(FIELD_MACHINEON) | fieldBit(FIELD_COFFEEFILTERHOLDER) | fieldBit(FIELD_HASCOFFEECAN), BREWING_TIMEOUT, 2, {
+		{ FIELD_MACHINEON, false, STAGE_IDLE },
+		{ FIELD_COFFEEFILTERHOLDER, true, STAGE_IDLE } } } // The holder is taken out to be cleaned
+};
+
+// Follows the brewing cycle through the changes of the status and tells which detectors
+// have to run. A transition is taken when its field changes between two updates, so the
+// value a field had when its detector stopped running doesn't move the cycle. When several
+// fields change between two updates, the stage a transition leads to also takes the other
+// changes, so none of them is lost. Every change moves the cycle only once.
+class BrewingCycle{
+public:
+	BrewingCycle() : stage(STAGE_IDLE), previous(0), started(false), unchanged(0) {
+	}
+
+	BrewingStage getStage() const {
+		return stage;
+	}
+
+	const char* getStageName() const {
+		return brewing_stages[stage].name;
+	}
+
+	// The fields of which the detectors run during the current stage
+	unsigned int detectors() const {
+		return brewing_stages[stage].detectors;
+	}
+
+	// Follow the changes of the status since the previous update, which was elapsed milliseconds
+	// ago. Returns true when the stage changed.
+	bool update(const StatusSnapshot& status, int elapsed){
+		if(!started){
+			previous = status.state;
+			started = true;
+			return false;
+		}
+
+		unsigned int changed = previous ^ status.state;
+		previous = status.state;
+
+		bool moved = false;
+		for(int steps = 0; steps < STAGE_COUNT && follow(status, changed); steps++){
+			moved = true;
+		}
+		if(moved){
+			return true;
+		}
+
+		// A cycle which was left halfway mustn't keep the machine from going idle
+		const BrewingStageInfo& info = brewing_stages[stage];
+		unchanged = (changed & info.detectors)? 0 : unchanged + elapsed;
+		if(info.timeout != 0 && unchanged >= info.timeout){
+			Logger::s(string("Brewing stage ") + getStageName() + " abandoned");
+			enter(STAGE_IDLE);
+			return true;
+		}
+		return false;
+	}
+
+private:
+	BrewingStage stage;
+	unsigned int previous; // State of the previous update
+	bool started;
+	int unchanged; // Milliseconds since one of the fields of the stage changed
+
+	// Take the transition of the current stage for one of the changed fields, that change is then
+	// used up. Returns true when the stage changed.
+	bool follow(const StatusSnapshot& status, unsigned int& changed){
+		const BrewingStageInfo& info = brewing_stages[stage];
+		for(int i = 0; i < info.count; i++){
+			const BrewingTransition& transition = info.transitions[i];
+			if((changed & fieldBit(transition.field)) && status.has(transition.field) == transition.value){
+				changed &= ~fieldBit(transition.field);
+				enter(transition.next);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void enter(BrewingStage next){
+		stage = next;
+		unchanged = 0;
+		Logger::s(string("Brewing stage: ") + getStageName());
+	}
+};
+
+#endif
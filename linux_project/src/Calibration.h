@@ -0,0 +1,189 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "opencv/cv.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "CoffeeMakerPosition.h"
+
+using namespace std;
+using namespace cv;
+
+// The following constants describe the calibration cross. The ratio is the height
+// of the rotated rectangle around the cross divided by its width.
+const double CROSS_RATIO = 0.21;
+const double CROSS_RATIO_EPS = 0.15;
+const int CROSS_THRESHOLD = 200; // Gray value used to separate the white cross from the background
+
+// The result of detecting the calibration cross inside one frame
+struct CalibrationSample{
+	Point2f center;
+	double width, height;
+	double ratio;
+	double angle;
+	double quality; // Between 0 and 1, indicates how well the shape matches the proportions of the cross
+};
+
+// Static helper class used by the handler to calibrate the program. Every frame
+// is searched for the calibration cross, afterwards the detections of all frames
+// are combined into one position. Detections that don't agree with the others
+// are rejected, so a reflection or a hand in one of the frames doesn't ruin
+// the calibration.
+class Calibration{
+public:
+	// Detect the calibration cross inside a grayscale frame. Returns false when no cross was found.
+	static bool detectCross(const Mat& gray, CalibrationSample& sample){
+		// Threshold frame to remove unwanted colors
+		Mat grayThresh;
+		threshold(gray, grayThresh, CROSS_THRESHOLD, 255, CV_THRESH_BINARY);
+
+		// Find contours in the remaining image
+		vector<vector<Point> > contours;
+		vector<Vec4i> hierarchy;
+		findContours(grayThresh, contours, hierarchy, CV_RETR_CCOMP, CV_CHAIN_APPROX_SIMPLE, Point(0, 0));
+
+		// Find the contour containing the calibration cross. When several contours qualify,
+		// the one with the proportions closest to the cross is used.
+		vector<Point> foundApprox;
+		double foundQuality = 0;
+		for(int i = 0; i < contours.size(); i++){
+			vector<Point> approx;
+			approxPolyDP(contours[i], approx, 5, true); // Find polygon points from contour points
+
+			// The cross has 8 contour points, this filters out the contours with too many or too little points.
+			if(approx.size() != 8){
+				continue;
+			}
+
+			// Since other shapes can contain 8 points, check if this shape has the proper proportions
+			double quality = shapeQuality(minAreaRect(contours[i]));
+			if(quality > foundQuality){
+				foundQuality = quality;
+				foundApprox = approx;
+			}
+		}
+
+		if(foundApprox.empty()){
+			return false;
+		}
+
+		// Refine the corners of the cross with sub-pixel accuracy and fit the rectangle on the refined corners
+		vector<Point2f> corners(foundApprox.begin(), foundApprox.end());
+		cornerSubPix(gray, corners, Size(5, 5), Size(-1, -1), TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.01));
+		RotatedRect rect = minAreaRect(corners);
+
+		// The wide line of the cross connects the diagonal (left top corner and right bottom corner),
+		// so the width of the machine is the diagonal of the rectangle.
+		double shortSide = min(rect.size.width, rect.size.height);
+		double longSide = max(rect.size.width, rect.size.height);
+		if(longSide <= 0){
+			return false;
+		}
+
+		Point2f rect_points[4];
+		rect.points(rect_points);
+		float dY = rect_points[3].y - rect_points[1].y;
+		float dX = rect_points[3].x - rect_points[1].x;
+
+		sample.center = rect.center;
+		sample.ratio = shortSide / longSide;
+		sample.width = sqrt(pow(rect.size.width, 2) + pow(rect.size.height, 2));
+		sample.height = sample.width * sample.ratio;
+		sample.angle = (dX != 0)? atan(dY / dX) : 0;
+		sample.quality = max(0.0, shapeQuality(rect));
+
+		return sample.quality > 0;
+	}
+
+	// Combine the detections of several frames into one position. Samples that are too
+	// far from the median are rejected as outliers. The confidence of the position is the
+	// fraction of frames which agreed on the result, weighted by the quality of the detections.
+	static bool combine(const vector<CalibrationSample>& samples, int frames, CoffeeMakerPosition& position){
+		if(samples.empty() || frames <= 0){
+			return false;
+		}
+
+		vector<double> xs, ys, widths, angles;
+		for(int i = 0; i < samples.size(); i++){
+			xs.push_back(samples[i].center.x);
+			ys.push_back(samples[i].center.y);
+			widths.push_back(samples[i].width);
+			angles.push_back(samples[i].angle);
+		}
+
+		double medianX = median(xs);
+		double medianY = median(ys);
+		double medianWidth = median(widths);
+		double medianAngle = median(angles);
+
+		// The allowed deviation is based on the median absolute deviation, with a lower bound
+		// so a perfectly still camera doesn't reject samples because of sub-pixel noise.
+		double centerTolerance = max(2.0, 3 * deviation(xs, medianX) + 3 * deviation(ys, medianY));
+		double widthTolerance = max(2.0, 3 * deviation(widths, medianWidth));
+		double angleTolerance = max(0.02, 3 * deviation(angles, medianAngle));
+
+		double sumX = 0, sumY = 0, sumWidth = 0, sumRatio = 0, sumAngle = 0, sumQuality = 0;
+		int inliers = 0;
+		for(int i = 0; i < samples.size(); i++){
+			const CalibrationSample& s = samples[i];
+			double distance = sqrt(pow(s.center.x - medianX, 2) + pow(s.center.y - medianY, 2));
+			if(distance > centerTolerance || fabs(s.width - medianWidth) > widthTolerance || fabs(s.angle - medianAngle) > angleTolerance){
+				continue;
+			}
+
+			sumX += s.center.x;
+			sumY += s.center.y;
+			sumWidth += s.width;
+			sumRatio += s.ratio;
+			sumAngle += s.angle;
+			sumQuality += s.quality;
+			inliers++;
+		}
+
+		if(inliers == 0){
+			return false;
+		}
+
+		int width = sumWidth / inliers;
+		int height = width * (sumRatio / inliers);
+		double confidence = ((double)inliers / frames) * (sumQuality / inliers);
+
+		position = CoffeeMakerPosition(cvRound(sumX / inliers), cvRound(sumY / inliers), width, height, (double)width / 200.0, sumAngle / inliers, confidence);
+		return true;
+	}
+
+private:
+	// Returns 1 for a rectangle with exactly the proportions of the cross, and decreases to 0
+	// at the edge of the allowed range. Negative values are outside of the range.
+	static double shapeQuality(const RotatedRect& rect){
+		double shortSide = min(rect.size.width, rect.size.height);
+		double longSide = max(rect.size.width, rect.size.height);
+		if(longSide <= 0){
+			return -1;
+		}
+
+		double ratio = shortSide / longSide;
+		return 1.0 - fabs(ratio - CROSS_RATIO) / (CROSS_RATIO * CROSS_RATIO_EPS);
+	}
+
+	static double median(vector<double> values){
+		sort(values.begin(), values.end());
+		int middle = values.size() / 2;
+		if(values.size() % 2 == 0){
+			return (values[middle - 1] + values[middle]) / 2.0;
+		}
+		return values[middle];
+	}
+
+	// Median absolute deviation around the given median
+	static double deviation(const vector<double>& values, double center){
+		vector<double> deviations;
+		for(int i = 0; i < values.size(); i++){
+			deviations.push_back(fabs(values[i] - center));
+		}
+		return median(deviations);
+	}
+};
+
+#endif
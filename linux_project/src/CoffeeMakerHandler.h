@@ -9,31 +9,32 @@
 #include <thread>
 #include "CoffeeMakerStatus.h"
 #include "CoffeeMakerPosition.h"
-
-#include "threads/CoffeeThread.h"
-#include "threads/CoffeeCanThread.h"
-#include "threads/CoffeeFilterHolderThread.h"
-#include "threads/MachineRunningThread.h"
-#include "threads/MachineOnThread.h"
-#include "threads/ReservoirOpenedThread.h"
-#include "threads/CoffeeFilterThread.h"
-#include "threads/WaterThread.h"
+#include "Calibration.h"
+#include "FramePyramid.h"
+#include "BayerIngest.h"
+#include "Display.h"
+#include "DetectorResult.h"
+#include "RingBuffer.h"
+#include "ColorMasks.h"
+#include "DetectorRegistry.h"
+#include "BrewingCycle.h"
+#include "ActivityMonitor.h"
+#include "TickScheduler.h"
+#include "DetectorContext.h"
+#include "LoadShedder.h"
+#include "sources/IFrameSource.h"
 #include <mutex>
+#include <sstream>
 
 using namespace std;
 using namespace cv;
 
-// The following constants define the names of all the windows
+// The name of the camera window, the windows of the threads are named after the detectors
 static const char* cam_window_name = "Camera";
-static const char* cam_coffeecan_name = "CoffeeCan Thread";
-static const char* cam_coffeefilterholder_name = "CoffeeFilterHolder Thread";
-static const char* cam_coffee_name = "Coffee Thread";
-static const char* cam_machinerunning_name = "MachineRunning Thread";
-static const char* cam_machineon_name = "MachineOn Thread";
-static const char* cam_reservoiropened_name = "ReservoirOpened Thread";
-static const char* cam_coffeefilter_name = "CoffeeFilter Thread";
-static const char* cam_water_name = "Water Thread";
-static const int frame_delay = 30; // Delay between frames
+static const int frame_delay = 30; // Delay between frames in milliseconds
+static const int sync_tolerance = 2 * frame_delay; // Largest difference between the capture times of the frames of a tick, in milliseconds
+static const int calibration_frames = 9; // Number of frames used to calibrate
+static const double min_calibration_confidence = 0.5; // Below this confidence a warning is shown
 static int windowwidth = 700; // Frame window width
 static int windowheight = 700; // Frame window height
 
@@ -44,8 +45,37 @@ static int windowheight = 700; // Frame window height
 class CoffeeMakerHandler : public ICoffeeMakerHandler
 {
 public:
-	CoffeeMakerHandler(VideoCapture* cam_top, VideoCapture* cam_side1, VideoCapture* cam_side2)
-		: cam_top(cam_top), cam_side1(cam_side1), cam_side2(cam_side2), runningthreads(0) {
+	CoffeeMakerHandler(IFrameSource* cam_top, IFrameSource* cam_side1, IFrameSource* cam_side2)
+		: events(0), cam_top(cam_top), cam_side1(cam_side1), cam_side2(cam_side2), half_ingest(false), debug(false), debug_tick(false), headless(false), converted(0), inputended(false), tickframes(0), running(0), tick(0), framenr(0) {
+		for(int c = 0; c < CAMERA_COUNT; c++){
+			capturetimes[c] = 0;
+		}
+	}
+
+	// Convert the raw frames directly to half resolution. The detectors then start at
+	// pyramid level 1, full resolution frames are never made.
+	void setHalfIngest(bool half){
+		half_ingest = half;
+	}
+
+	// Let the threads draw their debug images and show them in the windows
+	void setDebug(bool enabled){
+		debug = enabled;
+	}
+
+	// Publish the state changes and alarms of the machine on this stream
+	void setEventStream(EventStream* stream){
+		events = stream;
+	}
+
+	// Run without windows. The frames are then only converted when the threads need them.
+	void setHeadless(bool enabled){
+		headless = enabled;
+	}
+
+	// Use these alarm rules instead of the built-in ones
+	void setAlarmRules(shared_ptr<const AlarmRuleSet> rules){
+		alarmrules = rules;
 	}
 
 	// Initialization function of the program.
@@ -54,14 +84,16 @@ public:
 		Logger::i("================================", false);
 		Logger::v("Handler initialization started.");
 
-		coffeefilter_window_open = false;
-		water_window_open = false;
-		machinerunning_window_open = false;
-		coffee_window_open = false;
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			window_open[i] = false;
+		}
 
 		// Calibrate the program
 		if(calibrate()){
-			showFixedWindows();
+			if(!headless){
+				display.start();
+				showFixedWindows();
+			}
 
 			Logger::v("Handler initialization ended.");
 			return true;
@@ -71,113 +103,70 @@ public:
 	}
 
 	// This function is used to calibrate the program.
-	// The first frame is taken and the position of the 
-	// machine is detected. 
+	// The first frames are taken and the position of the 
+	// machine is detected in each of them. 
 	// The position contains besides an x and y value, also
 	// the zoom factor and the rotation of the machine.
+	// Detections which don't agree with the other frames are
+	// rejected, the remaining ones are averaged.
 	bool calibrate(){
 		Logger::v("Auto-calibration started.");
-		Mat frame;
-		*cam_side1 >> frame;
-		if(cam_side2 != 0){
-			*cam_side2 >> frame;
-		}
-		*cam_top >> frame; // Take all 3 frames to make sure the video sources stay in sync
-
-		// Blur image to remove noise
-		medianBlur(frame, frame, 3);
-		// Make grayscale
-		vector<Mat> channels;
-		split(frame, channels);
-		cvtColor(channels[0], frame, CV_BayerGB2GRAY);
-
-		// Threshold frame to remove unwanted colors
-		Mat grayThresh;
-		threshold(frame,grayThresh,200,255,CV_THRESH_BINARY); 
-
-		// Find contours in the remaining image
-		vector<vector<Point> > contours;
-		vector<Vec4i> hierarchy;
-		findContours( grayThresh, contours, hierarchy, CV_RETR_CCOMP, CV_CHAIN_APPROX_SIMPLE, Point(0, 0) );
-
-		Mat drawing = Mat::zeros( grayThresh.size(), CV_8UC3 );
-		// Find the contour containing the calibration cross
-		int found = -1;
-		RotatedRect foundRect;
-		float foundRatio;
-		bool foundTop; // If the most left point is matched to the bottom corner, this variable is false. True when the top corner is matched.
-		for( int i = 0; i< contours.size(); i++ )
-		{
-			vector<Point> contour= contours[i];
-			vector<Point> approx;
-			approxPolyDP(contour, approx, 5, true); // Find polygon points from contour points
-
-			const double ratioEPS = 0.15;
-			const double lowerratio = 0.21 * (1-ratioEPS);
-			const double upperratio = 0.21 * (1+ratioEPS);
-			// This line seems to work for each movie, because the cross has 8 contour points. Using this lines filters out the contours with too many or too little points.
-			if(approx.size() == 8){ 
-				// Find the box containing the polygon points. In general, the wide line of the cross connects the diagonal (left top corner and right bottom corner).
-				RotatedRect rect = minAreaRect(contour);
-				// Since other shapes can contain 8 points, check if this shape has the proper proportions
-
-				bool top = rect.size.height < rect.size.width;
-				double ratio = (top)? rect.size.height/rect.size.width : rect.size.width/rect.size.height;
-				
-				if( ratio > lowerratio && ratio <= upperratio){ // If the rotaded rectangle has the proper ratio, it's probably the box we are looking for.
-					found = i;
-					foundRect = rect;
-					foundRatio = ratio;
-					break;
-				}
+		vector<CalibrationSample> samples;
+		for(int i = 0; i < calibration_frames; i++){
+			// Grab all 3 frames to make sure the video sources stay in sync, only the top frame is used
+			SourceFrame raw;
+			if(!grabFrames() || !cam_top->retrieve(raw)){
+				break;
 			}
-		}
-
-
-		if(found != -1){
-			const float  PI_F=3.14159265358979f;
-
-			drawContours( drawing, contours, found, Scalar( 0,238,255 ), 2, 8, hierarchy, 0, Point() );
-
-			// Retrieve the rotated rectangle points
-			Point2f rect_points[4]; 
-			foundRect.points( rect_points );
-
-			// Calculate the position values
-			int width;
-			if(foundTop){
-				width = sqrt(pow(foundRect.size.width, 2) + pow(foundRect.size.height, 2));
+			rawsize = raw.image.size();
+
+			// The raw image can be a buffer of the driver, so it's never changed
+			Mat frame;
+			if(half_ingest){
+				// Use the same conversion as while running, so the cross is found in the same image
+				Mat rgb;
+				BayerIngest::halfResolution(raw.image, rgb);
+				cvtColor(rgb, frame, CV_RGB2GRAY);
+				medianBlur(frame, frame, 3);
 			} else {
-				width = sqrt(pow(foundRect.size.height, 2) + pow(foundRect.size.width, 2));
+				// Blur image to remove noise
+				medianBlur(raw.image, frame, 3);
+				// Make grayscale
+				vector<Mat> channels;
+				split(frame, channels);
+				cvtColor(channels[0], frame, CV_BayerGB2GRAY);
 			}
 
-			int height = width * foundRatio;
-
-			float dY = rect_points[3].y - rect_points[1].y;
-			float dX = rect_points[3].x - rect_points[1].x;
-			double angle = atan(dY / dX);
-			for( int j = 0; j < 4; j++ )
-				line( drawing, rect_points[j], rect_points[(j+1)%4], Scalar( 0,255,51 ), 1, 8 );
+			CalibrationSample sample;
+			if(Calibration::detectCross(frame, sample)){
+				samples.push_back(sample);
+			}
+		}
 
-			int x = foundRect.center.x;
-			int y = foundRect.center.y;
-			float ratio = (float)width/200.0; 
+		if(!Calibration::combine(samples, calibration_frames, position)){
+			return false;
+		}
 
-			circle(drawing, Point(x, y), 5, Scalar(255, 0, 0), 5);
+		// The position is always kept in full resolution coordinates
+		if(half_ingest){
+			position = position.scaled(2.0);
+		}
 
-			position = CoffeeMakerPosition(x, y, width, height, ratio, angle);
-			Logger::v("Auto-calibration done.");
+		stringstream message;
+		message << "Auto-calibration done (confidence " << position.getConfidence() << ").";
+		Logger::v(message.str());
 
-			return true;
-		} else {
-			return false;
+		if(position.getConfidence() < min_calibration_confidence){
+			Logger::i("Warning: the calibration cross was only found in a few frames, the detection may be unreliable.");
 		}
+
+		return true;
 	}
 
-	// Return the position of the machine (calculated during calibration)
-	virtual CoffeeMakerPosition getPosition(){
+	// Return the position of the machine (calculated during calibration), scaled to the pyramid level
+	virtual CoffeeMakerPosition getPosition(int level = 0){
 		std::lock_guard<std::mutex> lock(position_mutex);
-		return position;
+		return position.scaled(1.0 / (1 << level));
 	}
 
 	/*
@@ -185,85 +174,16 @@ public:
 		and are used in the threads to retrieve information from the handler class
 		or return results to it.
 	*/
-	virtual void CoffeeCanThreadEnded(bool hascoffeecan, Mat left_cam, Mat right_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);				
-		runningthreads -= 1;
-
-		//status.setHasCoffeeCanState(hascoffeecan);
-		//showCoffeeCanAlgo(left_cam, right_cam);
-	}
-
-	virtual void CoffeeCanThreadEnded(bool hascoffeecan, Mat side_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);				
-		runningthreads -= 1;
-
-		//status.setHasCoffeeCanState(hascoffeecan);
-		//showCoffeeCanAlgo(side_cam);
-
-	}
-
-	virtual void CoffeeThreadEnded(bool hascoffee, Mat top_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setHasCoffeeState(hascoffee);
-		//showCoffeeAlgo(top_cam);
-	}
-
-	virtual void CoffeeFilterHolderThreadEnded(bool hascoffeefilterholder, Mat top_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setCoffeeFilterHolderState(hascoffeefilterholder);
-		//showCoffeeFilterHolderAlgo(top_cam);
-	}
-
-	virtual void CoffeeFilterThreadEnded(bool hascoffeefilter, Mat top_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setHasFilterState(hascoffeefilter);
-		//showCoffeeFilterAlgo(top_cam);
-	}
-
-	virtual void MachineRunningThreadEnded(bool machinerunning, Mat top_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);				
-		runningthreads -= 1;
-
-		status.setMachineRunningState(machinerunning);
-		//showMachineRunningAlgo(top_cam);
-	}
-
-	virtual void MachineOnThreadEnded(bool machineon, Mat top_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setMachineOnState(machineon);	
-		//showMachineOnAlgo(top_cam);
-	}
-
-	virtual void ReservoirOpenedThreadEnded(bool opened, Mat top_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setReservoirOpenedState(opened);
-		//showReservoirOpenedAlgo(top_cam);
-	}
-
-	virtual void WaterThreadEnded(bool haswater, Mat left_cam, Mat right_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setWaterState(haswater);
-		//showWaterAlgo(left_cam, right_cam);
+	virtual void post(const DetectorResult& result){
+		// The queue is bigger than the number of threads, so it's only full when the
+		// handler thread is very late. Wait instead of losing the result.
+		while(!results.push(result)){
+			this_thread::yield();
+		}
 	}
 
-	virtual void WaterThreadEnded(bool haswater, Mat side_cam){
-		std::lock_guard<std::mutex> lock(threadend_mutex);		
-		runningthreads -= 1;
-
-		//status.setWaterState(haswater);
-		//showWaterAlgo(side_cam);
+	virtual bool isDebugging(){ // Only changes between two ticks, when no threads are running
+		return debug_tick;
 	}
 
 	virtual int getSideFrameCount(){ // Returns the number of side camera's used (1 or 2)
@@ -275,197 +195,366 @@ public:
 		}
 	}
 
-	virtual Mat getSideFrame(bool second){ // Gets one of the current side frames
-		std::lock_guard<std::mutex> lock(sideframe_mutex);
-		Mat side;
+	virtual int getLevel(int requested){ // Returns the pyramid level used for the requested level
+		return frames[tickframes].pyramids[CAMERA_TOP].getLevel(requested);
+	}
 
-		if(second){
-			currentframe_side2.copyTo(side);
-		} else {
-			currentframe_side1.copyTo(side);
-		}
+	virtual Mat getSideFrame(bool second, int level){ // Gets one of the side frames of the current tick
+		return frames[tickframes].pyramids[second? CAMERA_SIDE2 : CAMERA_SIDE1].get(level);
+	}
 
-		return side;
+	virtual Mat getTopFrame(int level){ // Returns the top frame of the current tick
+		return frames[tickframes].pyramids[CAMERA_TOP].get(level);
 	}
 
-	virtual Mat getTopFrame(){ // Returns the current top frame
-		std::lock_guard<std::mutex> lock(topframe_mutex);
-		Mat ret;
-		currentframe_top.copyTo(ret);
-		return ret;
+	virtual Mat getMask(int camera, int mask, int level){ // Returns a color mask of the current tick
+		return frames[tickframes].maskcaches[camera].get(mask, level);
 	}
 
 	// Execute the program
 	void run(){
 		Logger::v("Handler running...");
-		Logger::i("Press ESC to exit");
+		if(!headless){
+			Logger::i("Press a key in one of the windows to exit");
+		}
 
 		status = CoffeeMakerStatus();
-		int frameNr = 0;
-		int interval = 0;
-		int alarm_interval = 0;
+		cycle = BrewingCycle();
+		activity = ActivityMonitor();
+		lastgeneration = status.snapshot().generation;
+		logSchedule();
+		status.setEventStream(events);
+		if(alarmrules){
+			status.setAlarmRules(alarmrules);
+		}
+		framenr = 0;
+
+		// Frames and ticks are scheduled on the steady clock, so their rate doesn't depend on the load
+		TickScheduler frames;
+		TickScheduler ticks("Tick");
+		frames.start(frame_delay);
+		ticks.start(activity.tickInterval());
 
 		for(;;)
 		{
-			// Get the next frames
-			Mat frame_top, frame_side1, frame_side2;
-			*cam_top >> frame_top;
-			*cam_side1 >> frame_side1;
-			if(cam_side2 != 0){
-				*cam_side2 >> frame_side2;
-			}
-
-			// Exit of the frames are empty
-			if(frame_top.empty() || frame_side1.empty() || (cam_side2 != 0 && frame_side2.empty())){
+			// Grab the next frames of all camera's. They are only retrieved and converted when
+			// a thread or the display needs them. Exit at the end of the input.
+			if(!grabFrames()){
 				break;
 			}
 
-			// Convert the frames to RGB and store them inside the class
-			vector<Mat> channels;
-			split(frame_top, channels);
-			cvtColor(channels[0], currentframe_top, CV_BayerRG2RGB);
-
-			vector<Mat> channels2;
-			split(frame_side1, channels2);
-			cvtColor(channels2[0], currentframe_side1, CV_BayerRG2RGB);
+			framenr++;
 
-			if(cam_side2 != 0){
-				vector<Mat> channels3;
-				split(frame_side2, channels3);
-				cvtColor(channels3[0], currentframe_side2, CV_BayerRG2RGB);
-			}
+			// Process the results the threads returned since the previous frame
+			processResults();
 
-			if(interval > 333 && runningthreads == 0){	// EVERY THIRD OF A SECOND, START THREADS TO DETERMINE THE CURRENT 
-				// STATUS OF THE MACHINE. DON'T START THE THREADS IF THE THREADS 
-				// ARE STILL RUNNING FROM THE PREVIOUS ITERATION.
+			if(ticks.due()){	// EVERY THIRD OF A SECOND (EVERY SECOND WHEN IDLE), START THREADS TO
+				// DETERMINE THE CURRENT STATUS OF THE MACHINE. A DETECTOR WHICH IS STILL RUNNING FROM AN
+				// EARLIER TICK IS SKIPPED, THE OTHERS (AND THE SAFETY DETECTORS) DON'T WAIT FOR IT.
+				// THE ALARMS ARE CHECKED BY THE STATUS ITSELF WHEN A STATE CHANGES.
 
-				alarm_interval += 1;
-				if(alarm_interval == 3){
-					status.validate();
-					alarm_interval = 0;
-				}
+				handleTick(ticks.tick());
+				ticks.setPeriod(activity.tickInterval());
+			}
 
-				interval = 0;
-				startThreads();
+			// Visualize the current frames, when the display has shown the previous ones
+			if(display.wantsMosaic()){
+				convertFrames(allCameras());
+				showFrames();
 			}
 
-			// Visualize the current frames
-			if(cam_side2 != 0){
-				showFrames(currentframe_top, currentframe_side1, currentframe_side2);
-			} else {
-				showFrames(currentframe_top, currentframe_side1);
+			if(inputended){
+				break;
 			}
 
-			if(waitKey(frame_delay) >= 0) 
+			// Wait for the next frame. A late frame is taken right away.
+			this_thread::sleep_until(frames.getNext());
+			frames.tick();
+			if(display.exitRequested()) 
 				break;
-			interval += frame_delay;
 		}
+		joinThreads();
+		display.stop();
 		Logger::v("Handler stopped!");
 	}
 
 private:
 	CoffeeMakerStatus status; // Holds the status of the machine (has coffee? has filter? ...)
+	BrewingCycle cycle; // Stage of the brewing cycle, decides which detectors run
+	ActivityMonitor activity; // Decides how often the detectors run
+	unsigned int lastgeneration; // Generation of the status at the previous tick
 	CoffeeMakerPosition position; // Holds the position of the machine
+	EventStream* events; // Receives the state changes and alarms (optional)
+	shared_ptr<const AlarmRuleSet> alarmrules; // Alarm rules loaded from a file (optional)
+
+	IFrameSource* cam_top; // Top camera source
+	IFrameSource* cam_side1; // Side camera source
+	IFrameSource* cam_side2; // Second side camera source (optional)
+	bool half_ingest; // Convert the raw frames to half resolution instead of full resolution
+	bool debug; // Show the debug images of the threads
+	bool debug_tick; // Value of debug for the threads of the current tick
+	bool headless; // Don't show any windows
+
+	long long capturetimes[CAMERA_COUNT]; // Capture time of the converted frames, in microseconds (0 when unknown)
+	Size rawsize; // Size of the raw frames, taken during calibration
+	unsigned int converted; // Bit of every camera (1 << CAMERA_...) of which the current frame is retrieved and converted
+	bool inputended; // A grabbed frame couldn't be retrieved
+
+	// Grab the next frame of every camera. Returns false at the end of the input.
+	bool grabFrames(){
+		converted = 0;
+		bool grabbed = cam_top->grab();
+		grabbed = cam_side1->grab() && grabbed;
+		if(cam_side2 != 0){
+			grabbed = cam_side2->grab() && grabbed;
+		}
+		return grabbed;
+	}
 
-	VideoCapture* cam_top; // Top camera source
-	VideoCapture* cam_side1; // Side camera source
-	VideoCapture* cam_side2; // Second side camera source (optional)
-
-	Mat currentframe_top; // The current frame being executed (top)
-	Mat currentframe_side1; // The current frame being executed (side 1)
-	Mat currentframe_side2; // The current frame being executed (side 2)
-
-	// Threads
-	thread* coffeecan_thread;
-	thread* coffeefilterholder_thread;
-	thread* coffee_thread;
-	thread* machinerunning_thread;
-	thread* machineon_thread;
-	thread* reservoiropened_thread;
-	thread* coffeefilter_thread;
-	thread* water_thread;
-	// Number of executing threads. This is used to determine 
-	int runningthreads; 
+	// Convert a raw Bayer frame of one of the camera's to a color frame
+	void ingest(const Mat& raw, Mat& rgb){
+		if(half_ingest){
+			BayerIngest::halfResolution(raw, rgb);
+		} else {
+			BayerIngest::fullResolution(raw, rgb);
+		}
+	}
 
-	// Mutex for synchronizing the thread
-	std::mutex sideframe_mutex;
-	std::mutex topframe_mutex;
-	std::mutex threadend_mutex;
-	std::mutex position_mutex;
+	unsigned int allCameras(){
+		return (cam_side2 != 0)? 7u : 3u;
+	}
 
-	// Function to start the threads. Which threads to start depends on the status
-	// of the machine. When a thread is running, the corresponding output window is shown.
-	void startThreads(){		
-		// Always start these four threads
-		runningthreads = 4;
-		coffeecan_thread = new thread(CoffeeCanThread::exec, ref(*this)); 
-		coffeefilterholder_thread = new thread(CoffeeFilterHolderThread::exec, ref(*this));
-		machineon_thread = new thread(MachineOnThread::exec, ref(*this));
-		reservoiropened_thread = new thread(ReservoirOpenedThread::exec, ref(*this));
-
-		// Start conditional threads
-		if(status.getReservoirOpenedState()){ // If the reservoir is open, it's possible they will put water inside
-			runningthreads += 1;
-
-			if(!water_window_open){
-				showWaterWindow();
+	// Retrieve the current frames of the given camera's and convert them to RGB, unless that
+	// was already done for this frame. The current frames are tiles of the mosaic which is
+	// shown, so they are converted directly into it.
+	void convertFrames(unsigned int cameras){
+		if(converted == 0){
+			prepareMosaic(rawsize);
+		}
+
+		IFrameSource* sources[CAMERA_COUNT] = { cam_top, cam_side1, cam_side2 };
+		Mat* frames[CAMERA_COUNT] = { &currentframe_top, &currentframe_side1, &currentframe_side2 };
+		for(int c = 0; c < CAMERA_COUNT; c++){
+			unsigned int bit = 1u << c;
+			if(!(cameras & allCameras() & bit) || (converted & bit)){
+				continue;
+			}
+			// The raw frame is released right after the conversion, so a buffer of the driver is given back
+			SourceFrame raw;
+			if(!sources[c]->retrieve(raw)){
+				inputended = true; // The tile keeps its previous frame
+				continue;
 			}
+			ingest(raw.image, *frames[c]);
+			capturetimes[c] = raw.timestamp;
+			converted |= bit;
+		}
+	}
 
-			water_thread = new thread(WaterThread::exec, ref(*this));
-		} else {
-			if(water_window_open){
-				hideWaterWindow();
+	// Warn when the frames of a tick weren't captured at about the same time. Only the
+	// camera's with a capture time are compared.
+	void checkSync(unsigned int cameras){
+		long long first = 0, last = 0;
+		for(int c = 0; c < CAMERA_COUNT; c++){
+			if(!(cameras & converted & (1u << c)) || capturetimes[c] == 0){
+				continue;
 			}
+			if(first == 0 || capturetimes[c] < first){
+				first = capturetimes[c];
+			}
+			if(capturetimes[c] > last){
+				last = capturetimes[c];
+			}
+		}
+
+		if(last - first > sync_tolerance * 1000LL){
+			stringstream message;
+			message << "The camera frames of this tick were captured " << (last - first) / 1000 << " ms apart.";
+			Logger::v(message.str());
+		}
+	}
+
+	Display display; // Shows the windows on its own thread
+	Mat currentframe_top; // The current frame being executed (top), tile of the mosaic
+	Mat currentframe_side1; // The current frame being executed (side 1), tile of the mosaic
+	Mat currentframe_side2; // The current frame being executed (side 2), tile of the mosaic
+
+	// Point the current frames to their tile in the mosaic the display will show next. The
+	// mosaic is only allocated when the size of the frames changes. The top frame is placed at
+	// the top left, the first side frame at the bottom right and the second one at the bottom left.
+	// With only one side camera, the side frame is placed below the top frame.
+	void prepareMosaic(Size raw){
+		int framerows = half_ingest? raw.height / 2 : raw.height;
+		int framecols = half_ingest? raw.width / 2 : raw.width;
+		int mosaiccols = (cam_side2 != 0)? 2*framecols : framecols;
+
+		Mat& mosaic = display.mosaic();
+		if(mosaic.rows != 2*framerows || mosaic.cols != mosaiccols){
+			mosaic.create(2*framerows, mosaiccols, CV_8UC3);
+			mosaic.setTo(Scalar::all(0));
 		}
 
-		if(status.getCoffeeFilterHolderState()){ // If the coffeefilter is outside of the machine, it's possible they'll put a filter inside		
-			runningthreads += 1;
-			if(status.getHasFilterState()){ // If there is a filter, we need to detect if they put coffee inside
+		currentframe_top = mosaic(Rect(0,0,framecols,framerows));
+		if(cam_side2 != 0){
+			currentframe_side1 = mosaic(Rect(framecols,framerows,framecols,framerows));
+			currentframe_side2 = mosaic(Rect(0,framerows,framecols,framerows));
+		} else {
+			currentframe_side1 = mosaic(Rect(0,framerows,framecols,framerows));
+		}
+	}
 
-				if(!coffee_window_open){
-					showCoffeeWindow();
-				}
+	// The frames used by the threads, at several resolutions, and the color masks made from
+	// them. Every tick fills a set no running thread reads anymore.
+	TickFrames frames[TICK_FRAME_SETS];
+	int tickframes; // Set of the current tick
 
-				if(coffeefilter_window_open){
-					hideCoffeeFilterWindow();
-				}
+	// Threads of the detectors, indexed like the registry. Only used by the handler thread.
+	thread workers[DETECTOR_COUNT];
+	DetectorContext contexts[DETECTOR_COUNT]; // Context of every detector
+	unsigned int running; // Bit (1 << index) of every detector of which the thread isn't joined
+	LoadShedder shedder; // Chooses the detectors that fit in a tick
+	long tick; // Number of times the threads were started
+	long framenr; // Number of frames grabbed since the start, the results carry the one of their tick
+	RingBuffer<DetectorResult, 16> results; // Results posted by the threads, drained by processResults
 
+	// Mutex for synchronizing the thread
+	std::mutex sideframe_mutex;
+	std::mutex topframe_mutex;
+	std::mutex position_mutex;
 
-				coffee_thread = new thread(CoffeeThread::exec, ref(*this));			
-			} else { // We don't have a coffee filter yet, so detect a coffee filter
+	// Take the results of the threads out of the queue and apply them to the status.
+	// The status is only changed by the handler thread, so it doesn't need a lock.
+	void processResults(){
+		DetectorResult result;
+		while(results.pop(result)){
+			applyResult(result);
+		}
+	}
 
-				if(! coffeefilter_window_open){
-					showCoffeeFilterWindow();
-				}
+	void applyResult(const DetectorResult& result){
+		const DetectorInfo* detector = DetectorRegistry::find(result.field);
+		if(detector == 0){
+			return;
+		}
 
-				if(coffee_window_open){
-					hideCoffeeWindow();
-				}
+		if(detector->updatestatus){
+			status.setState(result.field, result.value, result.confidence * detector->calibration, result.frame);
+		}
 
-				coffeefilter_thread = new thread(CoffeeFilterThread::exec, ref(*this));
+		if(!result.debug.empty()){ // Only made when debugging
+			if(!result.debug_second.empty()){
+				showTwoUp(detector->name, result.debug, result.debug_second);
+			} else {
+				display.show(detector->name, result.debug);
 			}
-		} else {
-			if(coffee_window_open){
-				hideCoffeeWindow();
+		}
+	}
+
+	// Join the threads of the detectors which are done, or wait for all of them. The measured
+	// run times are given to the load shedder.
+	void joinThreads(bool wait = true){
+		for(int d = 0; d < DETECTOR_COUNT; d++){
+			if(!(running & (1u << d)) || (!wait && !contexts[d].isFinished())){
+				continue;
 			}
+			workers[d].join();
+			running &= ~(1u << d);
+			shedder.measured(d, contexts[d].getElapsed(), contexts[d].getLevelShift());
+		}
+	}
 
-			if(coffeefilter_window_open){
-				hideCoffeeFilterWindow();
+	// Returns a set of frames which no running detector reads, or -1 when they're all in use
+	int freeFrames(){
+		for(int s = 0; s < TICK_FRAME_SETS; s++){
+			bool used = false;
+			for(int d = 0; d < DETECTOR_COUNT; d++){
+				used = used || ((running & (1u << d)) && contexts[d].getFrames() == &frames[s]);
+			}
+			if(!used){
+				return s;
 			}
 		}
+		return -1;
+	}
+
+	// Check for motion and changes of the status since the previous tick (elapsed milliseconds ago).
+	// The threads are only started when the machine isn't idle.
+	void handleTick(int elapsed){
+		convertFrames(1u << CAMERA_TOP);
+		bool moved = activity.motion(currentframe_top);
+
+		StatusSnapshot current = status.snapshot();
+		bool changed = current.generation != lastgeneration;
+		lastgeneration = current.generation;
+
+		bool quiet = !current.has(FIELD_MACHINEON) && cycle.getStage() == STAGE_IDLE;
+		activity.update(moved || changed, quiet, elapsed);
+		if(!activity.isIdle()){
+			startThreads(elapsed);
+		}
+	}
 
-		if(status.getMachineOnState()){ // When the machine has been turned on, detect if the machine is still running
-			runningthreads += 1;
+	// Function to start the threads. Which threads to start depends on the stage of
+	// the brewing cycle, which follows the status of the machine. The tick started elapsed
+	// milliseconds after the previous one. When a thread can run, the corresponding output
+	// window is shown.
+	void startThreads(int elapsed){
+		// Take one snapshot of the status, so all decisions are based on the same state
+		if(cycle.update(status.snapshot(), elapsed)){
+			logSchedule();
+		}
+		unsigned int detectors = cycle.detectors();
+		debug_tick = debug;
+
+		// The detectors which are still running keep the frames of their tick. When the detectors
+		// of every set still run, the tick starts nothing.
+		joinThreads(false);
+		int set = freeFrames();
+		if(set < 0){
+			return;
+		}
 
-			if(!machinerunning_window_open){
-				showMachineRunningWindow();
+		// Only the detectors which fit in the time of a tick run, the most important ones first
+		DetectorPlan due = DetectorRegistry::plan(detectors, tick, getSideFrameCount());
+		DetectorPlan plan = shedder.select(due, tick, activity.tickInterval(), getSideFrameCount(), running);
+		tick++;
+
+		// Convert and copy the current frames of the camera's in the plan once for all threads. The
+		// smaller resolutions and the color masks are computed when the first thread asks for them.
+		convertFrames(plan.cameras);
+		checkSync(plan.cameras);
+		Mat* current[CAMERA_COUNT] = { &currentframe_top, &currentframe_side1, &currentframe_side2 };
+		int base = half_ingest? 1 : 0;
+		tickframes = set;
+		for(int c = 0; c < CAMERA_COUNT; c++){
+			if(plan.cameras & (1u << c)){
+				frames[set].pyramids[c].update(*current[c], base);
+				frames[set].maskcaches[c].reset(&frames[set].pyramids[c], plan.masks[c]);
 			}
-			machinerunning_thread = new thread(MachineRunningThread::exec, ref(*this));
-		} else {
-			if(machinerunning_window_open){
-				hideMachineRunningWindow();
+		}
+
+		// Every thread sees the handler through its context, which downscales it when needed and measures it
+		for(int i = 0; i < plan.count; i++){
+			int detector = plan.detectors[i];
+			contexts[detector].prepare(this, &frames[set], plan.levelshift[i], framenr);
+			workers[detector] = thread(&DetectorContext::run, &contexts[detector], detector_registry[detector].exec);
+			running |= 1u << detector;
+		}
+
+		if(!headless){
+			updateWindows(detectors);
+		}
+	}
+
+	// Tell which detectors run during the current stage of the brewing cycle
+	void logSchedule(){
+		string names;
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			if(DetectorRegistry::enabled(detector_registry[i], cycle.detectors())){
+				names += (names.empty()? "" : ", ") + string(detector_registry[i].name);
 			}
 		}
+		Logger::v(string("Detectors of the ") + cycle.getStageName() + " stage: " + names);
 	}
 
 	// Holds the window width of the output frame 
@@ -473,43 +562,23 @@ private:
 
 	// Open, resize and move the windows that are always shown
 	void showFixedWindows(){
-		namedWindow(cam_window_name, CV_WINDOW_KEEPRATIO );
-		namedWindow(cam_coffeecan_name, CV_WINDOW_KEEPRATIO );
-		namedWindow(cam_coffeefilterholder_name, CV_WINDOW_KEEPRATIO);
-		namedWindow(cam_reservoiropened_name, CV_WINDOW_KEEPRATIO);
-		namedWindow(cam_machineon_name, CV_WINDOW_KEEPRATIO);
-
-		// GET THE FIRST FRAME TO DETERMINE THE WINDOW SIZE
-		Mat frame;
-		*cam_top >> frame; // ALL 3 TO MAKE SURE THEY STAY IN SYNC
-		*cam_side1 >> frame;
-		if(cam_side2 != 0){
-			*cam_side2 >> frame;
-		}
-
+		// The size of the frames is known from the calibration
 		int totalwidth;
 		if(cam_side2 == 0){
-			totalwidth = frame.cols;
+			totalwidth = rawsize.width;
 		} else {
-			totalwidth = frame.cols*2;
+			totalwidth = rawsize.width*2;
 		}
-		int totalheight = frame.rows*2;
+		int totalheight = rawsize.height*2;
 
 		int height = windowheight;
 		double ratio = (double)height /(double)totalheight;
 		framewindow_width = (int)((double)totalwidth * ratio);
 
-		resizeWindow(cam_window_name, framewindow_width, height);
-		resizeWindow(cam_coffeecan_name, (cam_side2 != 0)? 400: 200, 180);
-		resizeWindow(cam_coffeefilterholder_name, 200, 180);
-		resizeWindow(cam_reservoiropened_name, 200, 180);
-		resizeWindow(cam_machineon_name, 200, 180);
+		display.openWindow(cam_window_name, framewindow_width, height, 0, 0);
 
-		moveWindow(cam_window_name, 0, 0);
-		moveWindow(cam_coffeefilterholder_name, framewindow_width+ 10, 0);
-		moveWindow(cam_coffeecan_name, framewindow_width+10, 220);
-		moveWindow(cam_reservoiropened_name, framewindow_width+ 10 + 210, 0);
-		moveWindow(cam_machineon_name, framewindow_width+ 10 + 210 + 210, 0);
+		// The windows of the threads of the first stage are opened now, the others when they can run
+		updateWindows(cycle.detectors());
 	}
 
 	/*
@@ -517,159 +586,48 @@ private:
 		the windows with the thread output depending on the running state
 		of the thread
 	*/
-	bool coffeefilter_window_open;
-	bool water_window_open;
-	bool machinerunning_window_open;
-	bool coffee_window_open;
-
-	void showCoffeeWindow(){
-		coffee_window_open = true;
-		namedWindow(cam_coffee_name, CV_WINDOW_KEEPRATIO);
-		resizeWindow(cam_coffee_name, 200, 180);
-		moveWindow(cam_coffee_name, framewindow_width+ 10, 440);
-	}
-
-	void hideCoffeeWindow(){
-		coffee_window_open = false;
-		destroyWindow(cam_coffee_name);
-	}
-
-	void showMachineRunningWindow(){
-		machinerunning_window_open = true;
-		namedWindow(cam_machinerunning_name, CV_WINDOW_KEEPRATIO);
-		resizeWindow(cam_machinerunning_name, 200, 180);
-		moveWindow(cam_machinerunning_name, framewindow_width+ 10 + 210, 440);
-	}
-
-	void hideMachineRunningWindow(){
-		machinerunning_window_open = false;
-		destroyWindow(cam_machinerunning_name);
-	}
-
-	void showCoffeeFilterWindow(){
-		coffeefilter_window_open = true;
-		namedWindow(cam_coffeefilter_name, CV_WINDOW_KEEPRATIO);
-		resizeWindow(cam_coffeefilter_name, 200, 180);
-		moveWindow(cam_coffeefilter_name, framewindow_width+ 10, 440);
-	}
-
-	void hideCoffeeFilterWindow(){
-		coffeefilter_window_open = false;
-		destroyWindow(cam_coffeefilter_name);
-	}
-
-	void showWaterWindow(){
-		water_window_open = true;
-		namedWindow(cam_water_name, CV_WINDOW_KEEPRATIO);
-		resizeWindow(cam_water_name, (cam_side2 != 0)? 400: 200, 180);
-		moveWindow(cam_water_name, framewindow_width+10 +  ((cam_side2 != 0)? 420: 210), 220);
-	}
-
-	void hideWaterWindow(){
-		water_window_open = false;
-		destroyWindow(cam_water_name);
+	bool window_open[DETECTOR_COUNT];
+
+	void updateWindows(unsigned int detectors){
+		bool two = (cam_side2 != 0);
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			const DetectorInfo& detector = detector_registry[i];
+			bool enabled = DetectorRegistry::enabled(detector, detectors);
+			if(enabled && !window_open[i]){
+				bool wide = two && detector.input == INPUT_SIDE;
+				int column = two? detector.windowcolumn_two : detector.windowcolumn;
+				display.openWindow(detector.name, wide? 400 : 200, 180, framewindow_width + 10 + column * 210, detector.windowrow * 220);
+			} else if(!enabled && window_open[i]){
+				display.closeWindow(detector.name);
+			}
+			window_open[i] = enabled;
+		}
 	}
 
 	/*
 		The following functions are used to write output to one of the windows
 	*/
 
-	void showCoffeeFilterHolderAlgo(const Mat& frame_top){
-		imshow(cam_coffeefilterholder_name, frame_top);
-	}
-
-	void showCoffeeFilterAlgo(const Mat& frame_top){
-		imshow(cam_coffeefilter_name, frame_top);
-	}
-
-	void showCoffeeAlgo(const Mat& frame_top){
-		imshow(cam_coffee_name, frame_top);
-	}
-
-	void showMachineRunningAlgo(const Mat& frame_top){
-		imshow(cam_machinerunning_name, frame_top);
-	}
-
-	void showMachineOnAlgo(const Mat& frame_top){
-		imshow(cam_machineon_name, frame_top);
-	}
-
-	void showReservoirOpenedAlgo(const Mat& frame_top){
-		imshow(cam_reservoiropened_name, frame_top);
-	}
-
-	void showCoffeeCanAlgo(const Mat& frame_side){
-		imshow(cam_coffeecan_name, frame_side);
-	}
-
-	void showCoffeeCanAlgo(const Mat& frame_left, const Mat& frame_right){
-		int framecols = frame_left.cols;
-		int framerows = frame_left.rows;
-		int frametype = frame_left.type();
-
-		Mat imgResult = Mat::zeros(framerows,2*framecols,frametype);
-
-		Mat roiImgResult_Left = imgResult(Rect(0,0,framecols,framerows));
-		Mat roiImgResult_Right = imgResult(Rect(framecols,0,framecols,framerows));
-
-		frame_right.copyTo(roiImgResult_Left); 
-		frame_left.copyTo(roiImgResult_Right); 
-
-		imshow(cam_coffeecan_name, imgResult);
-	}
-
-	void showWaterAlgo(const Mat& frame_side){
-		imshow(cam_water_name, frame_side);
-	}
-
-	void showWaterAlgo(const Mat& frame_left, const Mat& frame_right){
+	// Show two frames next to each other. The display keeps the view until it's shown, so every
+	// call needs a new one; this only happens when debugging.
+	void showTwoUp(const char* window, const Mat& frame_left, const Mat& frame_right){
 		int framecols = frame_left.cols;
 		int framerows = frame_left.rows;
-		int frametype = frame_left.type();
 
-		Mat imgResult = Mat::zeros(framerows,2*framecols,frametype);
+		Mat view(framerows,2*framecols,frame_left.type());
 
-		Mat roiImgResult_Left = imgResult(Rect(0,0,framecols,framerows));
-		Mat roiImgResult_Right = imgResult(Rect(framecols,0,framecols,framerows));
+		Mat roiImgResult_Left = view(Rect(0,0,framecols,framerows));
+		Mat roiImgResult_Right = view(Rect(framecols,0,framecols,framerows));
 
 		frame_right.copyTo(roiImgResult_Left); 
 		frame_left.copyTo(roiImgResult_Right); 
 
-		imshow(cam_water_name, imgResult);
-	}
-
-	void showFrames(const Mat& frame_top, const Mat& frame_side1, const Mat& frame_side2){
-		int framecols = frame_top.cols;
-		int framerows = frame_top.rows;
-		int frametype = frame_top.type();
-
-		Mat imgResult = Mat::zeros(2*framerows,2*framecols,frametype);
-
-		Mat roiImgResult_Side1 = imgResult(Rect(0,framerows,framecols,framerows));
-		Mat roiImgResult_Side2 = imgResult(Rect(framecols,framerows,framecols,framerows));
-		Mat roiImgResult_Top = imgResult(Rect(0,0,framecols,framerows));
-
-		frame_side2.copyTo(roiImgResult_Side1); 
-		frame_side1.copyTo(roiImgResult_Side2); 
-		frame_top.copyTo(roiImgResult_Top);
-
-		imshow(cam_window_name, imgResult);
+		display.show(window, view);
 	}
 
-	void showFrames(const Mat& frame_top, const Mat& frame_side){
-		int framecols = frame_top.cols;
-		int framerows = frame_top.rows;
-		int frametype = frame_top.type();
-
-		Mat imgResult = Mat::zeros(2*framerows,framecols,frametype);
-
-		Mat roiImgResult_Side = imgResult(Rect(0,framerows,framecols,framerows));
-		Mat roiImgResult_Top = imgResult(Rect(0,0,framecols,framerows));
-
-		frame_side.copyTo(roiImgResult_Side); 
-		frame_top.copyTo(roiImgResult_Top);
-
-		imshow(cam_window_name, imgResult);
+	// The camera frames are already converted into the mosaic, so it can be shown as it is
+	void showFrames(){
+		display.publishMosaic(cam_window_name);
 	}
 
 };
@@ -1,6 +1,8 @@
 #ifndef COFFEEMAKER_POSITION_H
 #define COFFEEMAKER_POSITION_H
 
+#include <math.h>
+
 // This class contains the positioning information of the coffeemachine.
 // The values are calculated during the initialization of the handler class. 
 // When calibration is done, using these values you can determine the exact
@@ -12,11 +14,11 @@
 class CoffeeMakerPosition{
 public:
 	CoffeeMakerPosition()
-		: x(0), y(0), width(0), height(0), ratio(0), angle(0) {
+		: x(0), y(0), width(0), height(0), ratio(0), angle(0), confidence(0) {
 	}
 
-	CoffeeMakerPosition(int x, int y, int width, int height, double ratio, double angle)
-		: x(x), y(y), width(width), height(height), ratio(ratio), angle(angle){
+	CoffeeMakerPosition(int x, int y, int width, int height, double ratio, double angle, double confidence = 1.0)
+		: x(x), y(y), width(width), height(height), ratio(ratio), angle(angle), confidence(confidence){
 	}
 
 	int getX(){
@@ -43,6 +45,16 @@ public:
 		return angle;
 	}
 
+	// Returns a value between 0 and 1 indicating how sure the calibration is about the position
+	double getConfidence(){
+		return confidence;
+	}
+
+	// Returns the position in a frame which is scaled with the given factor (e.g. 0.5 for half resolution)
+	CoffeeMakerPosition scaled(double factor){
+		return CoffeeMakerPosition(lround(x * factor), lround(y * factor), lround(width * factor), lround(height * factor), ratio * factor, angle, confidence);
+	}
+
 	friend ostream& operator<<(ostream& os, const CoffeeMakerPosition& pt);
 
 private:
@@ -50,6 +62,7 @@ private:
 	int width, height;
 	double ratio;
 	double angle;
+	double confidence;
 };
 
 ostream& operator<<(ostream& os, const CoffeeMakerPosition& dt)
@@ -58,6 +71,7 @@ ostream& operator<<(ostream& os, const CoffeeMakerPosition& dt)
 	os << "Size:\n\tWidth: " << dt.width << "\n\tHeight: " << dt.height << endl;
 	os << "Angle: " << dt.angle << endl;
 	os << "Ratio: " << dt.ratio << endl;
+	os << "Confidence: " << dt.confidence << endl;
 
     return os;
 }
@@ -2,9 +2,27 @@
 #define COFFEEMAKER_STATUS_H
 
 #include "ThresholdBool.h"
+#include "ConfidenceBool.h"
 #include "Logger.h"
-
-// The following contants contain the default value for all the ThresholdBools
+#include "StatusField.h"
+#include "StatusSnapshot.h"
+#include "AlarmRuleSet.h"
+#include "events/EventStream.h"
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+// The status booleans take the confidence of the detectors into account. Define
+// USE_THRESHOLD_BOOL to use the plain threshold bools instead.
+#ifdef USE_THRESHOLD_BOOL
+typedef ThresholdBool StatusBool;
+#else
+typedef ConfidenceBool StatusBool;
+#endif
+
+// The following contants contain the default value for all the ThresholdBools. They are
+// counted in detector results, and the detectors run once per tick (every ACTIVE_TICK ms
+// on the steady clock), so they stand for a fixed time.
 const int HASCOFFEECAN_THRESH = 6;
 const int RESERVOIROPEN_THRESH = 10;
 const int MACHINERUNNING_THRESH = 18;
@@ -17,19 +35,75 @@ const int HASWATER_THRESH = 10;
 // This class contains the current status of the coffee machine.
 // After a thread return it's result to the handler class, the handler
 // shall change the current status of the machine. To handle wrong
-// values ThresholdBools are used to make sure changes in the state
+// values ThresholdBools (or ConfidenceBools) are used to make sure changes in the state
 // of the machine don't happen immediately, but only when the machine
 // is sure about the result.
+//
+// The alarm rules (see AlarmRuleSet) are checked when one of the states changes.
+// Only the rules which read the changed state are evaluated, and an alarm is
+// only reported when it's raised and when it's cleared.
+//
+// The booleans are also kept in one bit mask, which is published as an atomic
+// snapshot after every change. The getters read the snapshot, so other threads
+// can read the status without locking while the detection threads update it.
 class CoffeeMakerStatus
 {
 public:
-	CoffeeMakerStatus() : hascoffeecan(HASCOFFEECAN_THRESH, true, true), reservoiropen(RESERVOIROPEN_THRESH, true), machinerunning(MACHINERUNNING_THRESH, true), machineon(MACHINEON_THRESH, true), coffeefilterholder(COFFEEFILTERHOLDER_THRESH, true), hascoffee(COFFEE_THRESH, false), hasfilter(HASFILTER_THRESH, false), haswater(HASWATER_THRESH, false) {
+	CoffeeMakerStatus() : hascoffeecan(HASCOFFEECAN_THRESH, true, true), reservoiropen(RESERVOIROPEN_THRESH, true), machinerunning(MACHINERUNNING_THRESH, true), machineon(MACHINEON_THRESH, true), coffeefilterholder(COFFEEFILTERHOLDER_THRESH, true), hascoffee(COFFEE_THRESH, false), hasfilter(HASFILTER_THRESH, false), haswater(HASWATER_THRESH, false), resultframe(0), events(0) {
+		mask = 0;
+		for(int i = 0; i < FIELD_COUNT; i++){
+			if(field(i)){
+				mask |= fieldBit(i);
+			}
+			confidences[i] = 1.0f;
+		}
+		published.store(mask);
+
+		setAlarmRules(AlarmRuleSet::defaults());
+	}
+
+	// Returns the current state of all the booleans at once
+	StatusSnapshot snapshot() const {
+		return published.load();
+	}
+
+	// Replace the alarm rules. The alarms which are active for the new rules are reported immediately.
+	void setAlarmRules(shared_ptr<const AlarmRuleSet> alarmrules){
+		rules = alarmrules;
+		active.assign(rules->size(), false);
+
+		for(int i = 0; i < rules->size(); i++){
+			evaluate(i, mask);
+		}
+	}
+
+	// Every state change and alarm is also published on this stream (optional)
+	void setEventStream(EventStream* stream){
+		events = stream;
 	}
 
-	void setHasCoffeeCanState(bool result){
+	// Update one of the fields, used for the results of the threads. The events of the
+	// change carry the confidence of the detector and the frame it was detected in.
+	void setState(StatusField field, bool result, float confidence = 1.0f, long frame = 0){
+		resultframe = frame;
+		switch(field){
+			case FIELD_HASCOFFEECAN: setHasCoffeeCanState(result, confidence); break;
+			case FIELD_RESERVOIROPEN: setReservoirOpenedState(result, confidence); break;
+			case FIELD_MACHINERUNNING: setMachineRunningState(result, confidence); break;
+			case FIELD_MACHINEON: setMachineOnState(result, confidence); break;
+			case FIELD_COFFEEFILTERHOLDER: setCoffeeFilterHolderState(result, confidence); break;
+			case FIELD_HASCOFFEE: setHasCoffeeState(result, confidence); break;
+			case FIELD_HASFILTER: setHasFilterState(result, confidence); break;
+			case FIELD_HASWATER: setWaterState(result, confidence); break;
+			default: break;
+		}
+	}
+
+	void setHasCoffeeCanState(bool result, float confidence = 1.0f){
 		bool temp = hascoffeecan;
 
-		hascoffeecan = result;
+		hascoffeecan.update(result, confidence);
+		confidences[FIELD_HASCOFFEECAN] = confidence;
 
 		if(temp != hascoffeecan){
 			if(hascoffeecan){
@@ -37,13 +111,16 @@ public:
 			} else {
 				Logger::s("- CoffeeCan has been taken OUTSIDE of the machine.");
 			}
+
+			fieldChanged(FIELD_HASCOFFEECAN, hascoffeecan);
 		}
 	}
 
-	void setReservoirOpenedState(bool result){
+	void setReservoirOpenedState(bool result, float confidence = 1.0f){
 		bool temp = reservoiropen;
 
-		reservoiropen = result;
+		reservoiropen.update(result, confidence);
+		confidences[FIELD_RESERVOIROPEN] = confidence;
 
 		if(temp != reservoiropen){
 			if(reservoiropen){
@@ -51,17 +128,20 @@ public:
 			} else {
 				Logger::s("- Water reservoir has been CLOSED.");
 			}
+
+			fieldChanged(FIELD_RESERVOIROPEN, reservoiropen);
 		}
 	}
 
 	bool getReservoirOpenedState(){
-		return reservoiropen;
+		return snapshot().has(FIELD_RESERVOIROPEN);
 	}
 
-	void setMachineRunningState(bool result){
+	void setMachineRunningState(bool result, float confidence = 1.0f){
 		bool temp = machinerunning;
 
-		machinerunning = result;
+		machinerunning.update(result, confidence);
+		confidences[FIELD_MACHINERUNNING] = confidence;
 
 		if(temp != machinerunning){
 			if(machinerunning){
@@ -69,13 +149,16 @@ public:
 			} else {
 				Logger::s("- Machine STOPPED working.");
 			}
+
+			fieldChanged(FIELD_MACHINERUNNING, machinerunning);
 		}
 	}
 
-	void setMachineOnState(bool result){
+	void setMachineOnState(bool result, float confidence = 1.0f){
 		bool temp = machineon;
 
-		machineon = result;
+		machineon.update(result, confidence);
+		confidences[FIELD_MACHINEON] = confidence;
 
 		if(temp != machineon){
 			if(machineon){
@@ -83,17 +166,20 @@ public:
 			} else {
 				Logger::s("- Machine has been turned OFF.");
 			}
+
+			fieldChanged(FIELD_MACHINEON, machineon);
 		}
 	}
 
 	bool getMachineOnState(){
-		return machineon;
+		return snapshot().has(FIELD_MACHINEON);
 	}
 
-	void setCoffeeFilterHolderState(bool result){
+	void setCoffeeFilterHolderState(bool result, float confidence = 1.0f){
 		bool temp = coffeefilterholder;
 
-		coffeefilterholder = result;
+		coffeefilterholder.update(result, confidence);
+		confidences[FIELD_COFFEEFILTERHOLDER] = confidence;
 
 		if(temp != coffeefilterholder){
 			if(coffeefilterholder){
@@ -101,105 +187,151 @@ public:
 			} else {
 				Logger::s("- CoffeeFilter holder has been put INSIDE of the machine.");
 			}
+
+			fieldChanged(FIELD_COFFEEFILTERHOLDER, coffeefilterholder);
 		}
 	}
 
 	bool getCoffeeFilterHolderState(){
-		return coffeefilterholder;
+		return snapshot().has(FIELD_COFFEEFILTERHOLDER);
 	}
 
-	void setHasCoffeeState(bool result){
+	void setHasCoffeeState(bool result, float confidence = 1.0f){
 		bool temp = hascoffee;
 
-		hascoffee = result;
+		hascoffee.update(result, confidence);
+		confidences[FIELD_HASCOFFEE] = confidence;
 
 		if(temp != hascoffee){
 			if(hascoffee){
 				Logger::s("+ Coffee has been put INSIDE of the filter.");
 			} 
+
+			fieldChanged(FIELD_HASCOFFEE, hascoffee);
 		}
 	}
 
-	void setHasFilterState(bool result){
+	void setHasFilterState(bool result, float confidence = 1.0f){
 		bool temp = hasfilter;
 
-		hasfilter = result;
+		hasfilter.update(result, confidence);
+		confidences[FIELD_HASFILTER] = confidence;
 
 		if(temp != hasfilter){
 			if(hasfilter){
 				Logger::s("+ A filter has been put INSIDE the CoffeeFilter holder.");
 			}
+
+			fieldChanged(FIELD_HASFILTER, hasfilter);
 		}
 	}
 
 	bool getHasFilterState(){
-		return hasfilter;
+		return snapshot().has(FIELD_HASFILTER);
 	}
 
-	void setWaterState(bool result){
+	void setWaterState(bool result, float confidence = 1.0f){
 		bool temp = haswater;
 
-		haswater = result;
+		haswater.update(result, confidence);
+		confidences[FIELD_HASWATER] = confidence;
 
 		if(temp != haswater){
 			if(haswater){
 				Logger::s("+ The machine has been filled with water.");
 			}
+
+			fieldChanged(FIELD_HASWATER, haswater);
 		}
 	}
 
-	// This function returns true or false indicating if the current state of the current machine is valid
-	// When the machine is running and the current state is not valid, an alarm message will be shown indicating
-	// the specific error
+	// This function returns true or false indicating if the current state of the current machine is valid.
+	// The state is invalid as long as one of the alarms is active.
 	bool validate(){ 
-		if(machineon && machinerunning){
-			bool valid = true;
-			if(!hascoffeecan){
-				valid = false;
-				Logger::a("!! The coffeecan needs to be inside the machine!");
+		for(int i = 0; i < active.size(); i++){
+			if(active[i]){
+				return false;
 			}
+		}
+		return true;
+	}
 
-			if(!hasfilter){
-				valid = false;
-				Logger::a("!! There is no coffee filter inside the coffee filter holder!");
-			}
+private:
+	// The filters and the mask are kept together, so updating the status touches as little memory as possible
+	StatusBool hascoffeecan;
+	StatusBool reservoiropen;
+	StatusBool machinerunning;
+	StatusBool machineon;
+	StatusBool coffeefilterholder;
+	StatusBool hascoffee;
+	StatusBool hasfilter;
+	StatusBool haswater;
+	unsigned int mask; // Bit of every field that is true
+	float confidences[FIELD_COUNT]; // Confidence of the latest detector result of every field
+	long resultframe; // Frame of the result which is being applied
+	SnapshotCell published; // Last published mask
+
+	EventStream* events;
+
+	shared_ptr<const AlarmRuleSet> rules;
+	vector<bool> active; // For every rule, true when its alarm is raised
+
+	const StatusBool& field(int field) const {
+		switch(field){
+			case FIELD_HASCOFFEECAN: return hascoffeecan;
+			case FIELD_RESERVOIROPEN: return reservoiropen;
+			case FIELD_MACHINERUNNING: return machinerunning;
+			case FIELD_MACHINEON: return machineon;
+			case FIELD_COFFEEFILTERHOLDER: return coffeefilterholder;
+			case FIELD_HASCOFFEE: return hascoffee;
+			case FIELD_HASFILTER: return hasfilter;
+			default: return haswater;
+		}
+	}
 
-			if(!hascoffee) {
-				valid = false;
-				Logger::a("!! There is no coffee inside the machine!");
-			}
+	// Called when the value of a field flipped
+	void fieldChanged(StatusField changed, const StatusBool& value){
+		if(value){
+			mask |= fieldBit(changed);
+		} else {
+			mask &= ~fieldBit(changed);
+		}
+		published.store(mask);
 
-			if(reservoiropen){
-				valid = false;
-				Logger::a("!! The water reservoir is still opened!");
-			}
+		if(events != 0){
+			events->publishState(statusFieldName(changed), value, confidences[changed], resultframe);
+		}
 
-			if(coffeefilterholder){
-				valid = false;
-				Logger::a("!! The coffee filter holder is outside of the machine!");
-			}
+		const vector<int>& affected = rules->dependents(changed);
+		for(int i = 0; i < affected.size(); i++){
+			evaluate(affected[i], mask);
+		}
+	}
 
-			if(!haswater || (!machinerunning)){ 
-				valid = false;
-				Logger::a("!! There is not enough water in the machine!");
-			}
+	void evaluate(int rule, unsigned int current){
+		bool raised = rules->evaluate(rule, current);
+		if(raised == active[rule]){
+			return;
+		}
+		active[rule] = raised;
 
-			return valid;
-			
+		if(raised){
+			Logger::a("!! " + rules->rule(rule).message);
 		} else {
-			return true;
+			Logger::a("-- Alarm cleared: " + rules->rule(rule).message);
 		}
-	}
 
-private:
-	ThresholdBool hascoffeecan;
-	ThresholdBool reservoiropen;
-	ThresholdBool machinerunning;
-	ThresholdBool machineon;
-	ThresholdBool coffeefilterholder;
-	ThresholdBool hascoffee;
-	ThresholdBool hasfilter;
-	ThresholdBool haswater;
+		if(events != 0){
+			// The alarm is as reliable as the least reliable detector result it depends on
+			double confidence = 1.0;
+			for(int i = 0; i < FIELD_COUNT; i++){
+				if(rules->rule(rule).fields & fieldBit(i)){
+					confidence = min(confidence, (double)confidences[i]);
+				}
+			}
+			events->publishAlarm(rules->rule(rule).name, rules->rule(rule).message, raised, confidence, resultframe);
+		}
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef COLORMASKS_H
+#define COLORMASKS_H
+
+#include "opencv/cv.h"
+#include "FramePyramid.h"
+#include "CoffeeMakerPosition.h"
+#include "threads/Helper.h"
+#include <mutex>
+
+using namespace cv;
+
+// The color ranges the detectors look for. A detector asks the handler for one of
+// these masks instead of filtering the frame itself, so detectors using the same
+// color on the same camera share the HSV conversion and the filtering.
+enum ColorMask {
+	MASK_RED = 0, // Coffee filter holder and the lid of the water reservoir
+	MASK_GREEN, // Coffee can and water
+	MASK_BLUE, // Light of the running machine
+	MASK_COUNT
+};
+
+struct ColorMaskRange {
+	Scalar lower, upper; // HSV range
+	int blursize; // Size of the median filter at full resolution
+};
+
+static const ColorMaskRange color_mask_ranges[MASK_COUNT] = {
+	{ Scalar(0,208,166), Scalar(98,256,256), 5 },
+	{ Scalar(60, 170, 16), Scalar(73, 256, 256), 5 },
+	{ Scalar(109, 250, 90), Scalar(119, 256, 256), 3 }
+};
+
+// Returns the bit of a mask inside a set of masks
+inline unsigned int maskBit(int mask){
+	return 1u << mask;
+}
+
+// The HSV frames and the color masks of one camera, made from the levels of its pyramid.
+// Everything is computed when the first detector asks for it, and shared during the tick.
+// The first request for a level also computes the other masks the detectors of the tick
+// will need at that level, so the HSV frame is only read once while it's in the cache.
+class MaskCache{
+public:
+	MaskCache() : pyramid(0), valid(0) {
+		for(int l = 0; l < PYRAMID_LEVELS; l++){
+			needed[l] = 0;
+		}
+	}
+
+	// Forget the masks of the previous frame. masks holds, per requested pyramid level, the
+	// masks the detectors of this tick use. They are kept at the level the pyramid gives.
+	void reset(FramePyramid* frames, const unsigned int masks[PYRAMID_LEVELS]){
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		pyramid = frames;
+		for(int l = 0; l < PYRAMID_LEVELS; l++){
+			needed[l] = 0;
+		}
+		for(int l = 0; l < PYRAMID_LEVELS; l++){
+			needed[pyramid->getLevel(l)] |= masks[l];
+		}
+		valid = 0;
+	}
+
+	// Returns the filtered mask at the given pyramid level. The mask is shared, don't modify it.
+	Mat get(int mask, int level){
+		level = pyramid->getLevel(level);
+
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		if(!(valid & bit(level, mask))){
+			unsigned int compute = needed[level] | maskBit(mask);
+			for(int m = 0; m < MASK_COUNT; m++){
+				if((compute & maskBit(m)) && !(valid & bit(level, m))){
+					filter(level, m);
+				}
+			}
+		}
+		return masks[level][mask];
+	}
+
+private:
+	FramePyramid* pyramid;
+	unsigned int needed[PYRAMID_LEVELS]; // Masks used at every level
+	Mat hsvframes[PYRAMID_LEVELS];
+	Mat masks[PYRAMID_LEVELS][MASK_COUNT];
+	unsigned int valid; // Bit of every HSV frame and mask that is computed for the current frame
+	std::mutex cache_mutex;
+
+	static unsigned int bit(int level, int mask){
+		return 1u << (level * MASK_COUNT + mask);
+	}
+
+	void filter(int level, int mask){
+		// Every tick gets new masks, so the masks of the previous tick can still be shown
+		const ColorMaskRange& range = color_mask_ranges[mask];
+		masks[level][mask] = Helper::filterColor(hsv(level), range.lower, range.upper, Helper::kernel(range.blursize, level));
+		valid |= bit(level, mask);
+	}
+
+	// The HSV frames use the bits after the masks
+	const Mat& hsv(int level){
+		unsigned int bit = 1u << (PYRAMID_LEVELS * MASK_COUNT + level);
+		if(!(valid & bit)){
+			hsvframes[level] = Helper::convertToHSV(pyramid->get(level));
+			valid |= bit;
+		}
+		return hsvframes[level];
+	}
+};
+
+#endif
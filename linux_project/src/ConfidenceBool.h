@@ -0,0 +1,118 @@
+#ifndef ConfidenceBool_H
+#define ConfidenceBool_H
+
+// The following constants define how fast a confidence bool reacts
+const float CONFIDENCE_ATTACK = 0.25f; // Part of the threshold added by a fully confident true sample
+const float CONFIDENCE_DECAY = 0.15f; // Part of the threshold removed by a fully confident false sample
+const float CONFIDENCE_HYSTERESIS = 0.1f; // Part of the threshold around threshold/2 in which the value doesn't change
+const float CONFIDENCE_TRUSTED = 0.6f; // Samples up to this confidence never move faster than a threshold bool sample
+const int CONFIDENCE_SCALE = 16; // Fixed point scale of the inner value
+
+// The confidence bool is an alternative to the threshold bool which takes into
+// account how sure the detector was about its result. A sample with a confidence
+// up to CONFIDENCE_TRUSTED moves the inner value at most as much as a sample of the
+// threshold bool, proportional to its confidence, so doubtful samples never change
+// the state faster than before. Only samples above it move the value further, up
+// to the attack or decay part of the threshold for a fully confident sample, so a
+// detector which is certain changes the state in a few samples. True samples move
+// the value faster than false samples (attack and decay). The detectors without a
+// real score have their confidence scaled down before it gets here (see DetectorRegistry).
+//
+// The value only becomes true when the inner value is above threshold/2 plus
+// the hysteresis, and only becomes false again when it drops below threshold/2
+// minus the hysteresis, so the bool doesn't flip back and forth when the inner
+// value hovers around the middle.
+//
+// Setting the bool without a confidence moves the inner value with 1, just
+// like the threshold bool, so both can be used in the CoffeeMakerStatus.
+class ConfidenceBool
+{
+public:
+	ConfidenceBool(int threshold, bool reversable) : threshold(threshold), level(0), state(false), reversable(reversable) {
+	}
+
+	ConfidenceBool(int threshold, bool on, bool reversable) : threshold(threshold), level(on? threshold * CONFIDENCE_SCALE : 0), state(on), reversable(reversable) {
+	}
+
+	operator const bool() const {
+		return state;
+	}
+
+	// Returns how sure the confidence bool is about its value, between 0 and 1.
+	// This is 1 when the inner value is at the threshold (for true) or at 0 (for false).
+	double getConfidence() const {
+		double filled = (double)level / (threshold * CONFIDENCE_SCALE);
+		return state? filled : 1.0 - filled;
+	}
+
+	ConfidenceBool & operator = (bool v){
+		return add(v, CONFIDENCE_SCALE);
+	}
+
+	// Add a sample with a confidence between 0 and 1
+	ConfidenceBool & update(bool v, float confidence){
+		if(confidence < 0){
+			confidence = 0;
+		} else if(confidence > 1){
+			confidence = 1;
+		}
+
+		// Up to the trusted confidence a sample moves like a part of a threshold bool sample,
+		// above it the step grows to the full gain. A fully confident sample never moves
+		// slower than a sample of the threshold bool.
+		float gain = threshold * (v? CONFIDENCE_ATTACK : CONFIDENCE_DECAY);
+		if(gain < 1){
+			gain = 1;
+		}
+		float step;
+		if(confidence <= CONFIDENCE_TRUSTED){
+			step = confidence / CONFIDENCE_TRUSTED;
+		} else {
+			step = 1 + (gain - 1) * (confidence - CONFIDENCE_TRUSTED) / (1 - CONFIDENCE_TRUSTED);
+		}
+
+		return add(v, (int)(step * CONFIDENCE_SCALE + 0.5f));
+	}
+
+	ConfidenceBool & operator &= (bool v){
+		level = v? threshold * CONFIDENCE_SCALE : 0;
+		state = v;
+
+		return *this;
+	}
+
+private:
+	unsigned char threshold;
+	unsigned short level; // Inner value, multiplied with CONFIDENCE_SCALE
+	bool state;
+	bool reversable;
+
+	ConfidenceBool & add(bool v, int step){
+		int maximum = threshold * CONFIDENCE_SCALE;
+		int value = level;
+		if(v){
+			value += step;
+		} else if(reversable){
+			value -= step;
+		}
+
+		if(value > maximum){
+			value = maximum;
+		}
+		if(value < 0){
+			value = 0;
+		}
+		level = value;
+
+		int band = (int)(maximum * CONFIDENCE_HYSTERESIS);
+		if(!state && 2 * level > maximum + 2 * band){
+			state = true;
+		} else if(state && 2 * level <= maximum - 2 * band){
+			state = false;
+		}
+
+		return *this;
+	}
+};
+
+#endif
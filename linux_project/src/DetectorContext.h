@@ -0,0 +1,110 @@
+#ifndef DETECTORCONTEXT_H
+#define DETECTORCONTEXT_H
+
+#include "ICoffeeMakerHandler.h"
+#include "FramePyramid.h"
+#include "ColorMasks.h"
+#include <chrono>
+#include <atomic>
+
+const int TICK_FRAME_SETS = 3; // Ticks of which the frames can be in use at the same time
+
+// The frames of one tick at every pyramid level and the color masks made from them, per camera.
+// The detectors of a tick read them until they're done, while the next tick fills another set.
+struct TickFrames {
+	FramePyramid pyramids[CAMERA_COUNT];
+	MaskCache maskcaches[CAMERA_COUNT];
+};
+
+// The handler as one detector sees it during a tick. The frames and masks come from the
+// frames of the tick the detector started in, even when the handler started the next tick
+// meanwhile. The other calls are passed to the handler. The detector can be moved to a
+// smaller pyramid level (downscaled) when the tick has no time for the full one. The
+// context also measures how long the detector ran.
+class DetectorContext : public ICoffeeMakerHandler{
+public:
+	DetectorContext() : handler(0), frames(0), levelshift(0), frame(0), elapsed(0), finished(true) {
+	}
+
+	// Prepare the context for the tick started at the given frame, the detector reads the given
+	// frames and runs levelshift levels smaller than it asks
+	void prepare(ICoffeeMakerHandler* parent, TickFrames* tickframes, int shift, long framenr){
+		handler = parent;
+		frames = tickframes;
+		levelshift = shift;
+		frame = framenr;
+		elapsed = 0;
+		finished = false;
+	}
+
+	// Run the detector, on the thread of the detector
+	void run(void (*exec)(ICoffeeMakerHandler&)){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		exec(*this);
+		elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		finished = true;
+	}
+
+	// True when the detector is done, its thread can then be joined without waiting
+	bool isFinished() const {
+		return finished;
+	}
+
+	// Microseconds the detector ran, only valid when its thread is joined
+	long long getElapsed() const {
+		return elapsed;
+	}
+
+	TickFrames* getFrames() const {
+		return frames;
+	}
+
+	int getLevelShift() const {
+		return levelshift;
+	}
+
+	// The result is stamped with the frame of the tick, the handler may be frames further when it reads it
+	virtual void post(const DetectorResult& result){
+		DetectorResult stamped = result;
+		stamped.frame = frame;
+		handler->post(stamped);
+	}
+
+	virtual bool isDebugging(){
+		return handler->isDebugging();
+	}
+
+	virtual int getLevel(int requested){
+		return frames->pyramids[CAMERA_TOP].getLevel(min(requested + levelshift, PYRAMID_LEVELS - 1));
+	}
+
+	virtual Mat getTopFrame(int level){
+		return frames->pyramids[CAMERA_TOP].get(level);
+	}
+
+	virtual int getSideFrameCount(){
+		return handler->getSideFrameCount();
+	}
+
+	virtual Mat getSideFrame(bool second, int level){
+		return frames->pyramids[second? CAMERA_SIDE2 : CAMERA_SIDE1].get(level);
+	}
+
+	virtual CoffeeMakerPosition getPosition(int level){
+		return handler->getPosition(level);
+	}
+
+	virtual Mat getMask(int camera, int mask, int level){
+		return frames->maskcaches[camera].get(mask, level);
+	}
+
+private:
+	ICoffeeMakerHandler* handler;
+	TickFrames* frames; // Frames of the tick the detector runs in
+	int levelshift;
+	long frame; // Frame the tick started at
+	long long elapsed;
+	std::atomic<bool> finished; // Set by the thread of the detector when it's done
+};
+
+#endif
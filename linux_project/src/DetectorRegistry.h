@@ -0,0 +1,150 @@
+#ifndef DETECTORREGISTRY_H
+#define DETECTORREGISTRY_H
+
+#include "ICoffeeMakerHandler.h"
+#include "StatusField.h"
+#include "ConfidenceBool.h"
+#include "ColorMasks.h"
+
+#include "threads/CoffeeThread.h"
+#include "threads/CoffeeCanThread.h"
+#include "threads/CoffeeFilterHolderThread.h"
+#include "threads/MachineRunningThread.h"
+#include "threads/MachineOnThread.h"
+#include "threads/ReservoirOpenedThread.h"
+#include "threads/CoffeeFilterThread.h"
+#include "threads/WaterThread.h"
+
+// The camera's a detector looks at
+enum DetectorInput {
+	INPUT_TOP, // The top camera
+	INPUT_SIDE // All the side camera's
+};
+
+// How important a detector is when the box is overloaded (see LoadShedder)
+enum DetectorPriority {
+	PRIORITY_SAFETY = 0, // Always runs, the alarms about dangerous situations depend on it
+	PRIORITY_NORMAL, // Skipped when there is no time left
+	PRIORITY_OPTIONAL // Skipped or downscaled first
+};
+
+// Describes one detector: what it needs, how often it runs, how important it is and where
+// its debug window is shown. Adding a detector means adding a thread and a line to the registry. When a detector
+// runs is decided by the brewing cycle (see BrewingCycle).
+struct DetectorInfo {
+	const char* name; // Also the name of its debug window
+	StatusField field; // The field of the status it detects
+	void (*exec)(ICoffeeMakerHandler&);
+	DetectorInput input;
+	int level; // Pyramid level of the frames
+	unsigned int masks; // Color masks it asks for (maskBit)
+	int cadence; // Runs every cadence ticks
+	DetectorPriority priority;
+	bool downscale; // Can run one pyramid level smaller when there is no time for the normal level
+	bool updatestatus; // When false the result is only shown, the status isn't updated
+	float calibration; // Multiplies its confidence: 1 for a real score, CONFIDENCE_TRUSTED for a coarse heuristic (see ConfidenceBool)
+	int windowrow; // Position of the debug window, in rows of 220 pixels
+	int windowcolumn; // Position in columns of 210 pixels, with one side camera
+	int windowcolumn_two; // Position in columns, with two side camera's (the side windows are twice as wide)
+};
+
+static const DetectorInfo detector_registry[] = {
+	{ "CoffeeCan Thread", FIELD_HASCOFFEECAN, CoffeeCanThread::exec, INPUT_SIDE, CoffeeCanThread::PYRAMID_LEVEL,
+		maskBit(MASK_GREEN), 1, PRIORITY_OPTIONAL, true, true, 1.0f, 1, 0, 0 },
+	{ "CoffeeFilterHolder Thread", FIELD_COFFEEFILTERHOLDER, CoffeeFilterHolderThread::exec, INPUT_TOP, CoffeeFilterHolderThread::PYRAMID_LEVEL,
+		maskBit(MASK_RED), 1, PRIORITY_NORMAL, false, true, CONFIDENCE_TRUSTED, 0, 0, 0 },
+	{ "MachineOn Thread", FIELD_MACHINEON, MachineOnThread::exec, INPUT_TOP, MachineOnThread::PYRAMID_LEVEL,
+		0, 1, PRIORITY_SAFETY, false, true, CONFIDENCE_TRUSTED, 0, 2, 2 },
+	{ "ReservoirOpened Thread", FIELD_RESERVOIROPEN, ReservoirOpenedThread::exec, INPUT_TOP, ReservoirOpenedThread::PYRAMID_LEVEL,
+		maskBit(MASK_RED), 1, PRIORITY_SAFETY, false, true, 1.0f, 0, 1, 1 },
+	// The water result is only shown: haswater can't become false again, so one wrong result would
+	// keep it true. Without it the reservoir open stage ends when the reservoir is closed.
+	{ "Water Thread", FIELD_HASWATER, WaterThread::exec, INPUT_SIDE, WaterThread::PYRAMID_LEVEL,
+		maskBit(MASK_GREEN), 1, PRIORITY_OPTIONAL, true, false, CONFIDENCE_TRUSTED, 1, 1, 2 },
+	{ "Coffee Thread", FIELD_HASCOFFEE, CoffeeThread::exec, INPUT_TOP, CoffeeThread::PYRAMID_LEVEL,
+		maskBit(MASK_RED), 1, PRIORITY_NORMAL, false, true, 1.0f, 2, 0, 0 },
+	{ "CoffeeFilter Thread", FIELD_HASFILTER, CoffeeFilterThread::exec, INPUT_TOP, CoffeeFilterThread::PYRAMID_LEVEL,
+		maskBit(MASK_RED), 1, PRIORITY_NORMAL, false, true, 1.0f, 2, 0, 0 },
+	{ "MachineRunning Thread", FIELD_MACHINERUNNING, MachineRunningThread::exec, INPUT_TOP, MachineRunningThread::PYRAMID_LEVEL,
+		maskBit(MASK_BLUE), 1, PRIORITY_SAFETY, false, true, CONFIDENCE_TRUSTED, 2, 1, 1 }
+};
+
+const int DETECTOR_COUNT = sizeof(detector_registry) / sizeof(detector_registry[0]);
+
+// The detectors which run during one tick, and the inputs they need together
+struct DetectorPlan {
+	int detectors[DETECTOR_COUNT]; // Index in the registry
+	int levelshift[DETECTOR_COUNT]; // Number of pyramid levels the detector is downscaled
+	int count;
+	unsigned int cameras; // Bit of every camera used (1 << CAMERA_...)
+	unsigned int masks[CAMERA_COUNT][PYRAMID_LEVELS]; // Color masks used per camera and pyramid level
+};
+
+class DetectorRegistry{
+public:
+	// Returns the detector which detects the given field, or 0 when there is none
+	static const DetectorInfo* find(int field){
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			if(detector_registry[i].field == field){
+				return &detector_registry[i];
+			}
+		}
+		return 0;
+	}
+
+	// True when the detector is one of the enabled detectors (bit of the field they detect)
+	static bool enabled(const DetectorInfo& detector, unsigned int detectors){
+		return (detectors & fieldBit(detector.field)) != 0;
+	}
+
+	// Make the plan for the given tick: the detectors which are enabled and due, and the camera's and masks they use
+	static DetectorPlan plan(unsigned int detectors, long tick, int sidecameras){
+		DetectorPlan plan = empty();
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			const DetectorInfo& detector = detector_registry[i];
+			if(enabled(detector, detectors) && tick % detector.cadence == 0){
+				add(plan, i, 0, sidecameras);
+			}
+		}
+		return plan;
+	}
+
+	static DetectorPlan empty(){
+		DetectorPlan plan;
+		plan.count = 0;
+		plan.cameras = 0;
+		for(int c = 0; c < CAMERA_COUNT; c++){
+			for(int l = 0; l < PYRAMID_LEVELS; l++){
+				plan.masks[c][l] = 0;
+			}
+		}
+		return plan;
+	}
+
+	// Add a detector to the plan, together with the camera's and masks it uses
+	static void add(DetectorPlan& plan, int index, int levelshift, int sidecameras){
+		const DetectorInfo& detector = detector_registry[index];
+		plan.detectors[plan.count] = index;
+		plan.levelshift[plan.count] = levelshift;
+		plan.count++;
+
+		// The masks are used at the level the detector runs at, after downscaling
+		int level = min(detector.level + levelshift, PYRAMID_LEVELS - 1);
+		if(detector.input == INPUT_TOP){
+			addCamera(plan, CAMERA_TOP, detector.masks, level);
+		} else {
+			addCamera(plan, CAMERA_SIDE1, detector.masks, level);
+			if(sidecameras == 2){
+				addCamera(plan, CAMERA_SIDE2, detector.masks, level);
+			}
+		}
+	}
+
+private:
+	static void addCamera(DetectorPlan& plan, int camera, unsigned int masks, int level){
+		plan.cameras |= 1u << camera;
+		plan.masks[camera][level] |= masks;
+	}
+};
+
+#endif
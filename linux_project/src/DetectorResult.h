@@ -0,0 +1,29 @@
+#ifndef DETECTORRESULT_H
+#define DETECTORRESULT_H
+
+#include "opencv/cv.h"
+#include "StatusField.h"
+
+using namespace cv;
+
+// The result of one detection thread. Every thread detects one field of the status,
+// so the field also identifies the thread. The debug images are only set when the
+// handler is debugging, otherwise they are empty and copying the result doesn't
+// allocate anything.
+struct DetectorResult {
+	DetectorResult() : field(FIELD_COUNT), value(false), confidence(0), frame(0) {
+	}
+
+	DetectorResult(StatusField field, bool value, float confidence)
+		: field(field), value(value), confidence(confidence), frame(0) {
+	}
+
+	StatusField field; // The field of the status which was detected
+	bool value;
+	float confidence; // Between 0 and 1
+	long frame; // Number of the frame of the tick the result was detected in, set by the context
+	Mat debug; // Output of the algorithm (optional)
+	Mat debug_second; // Output for the second side camera, when the thread uses both (optional)
+};
+
+#endif
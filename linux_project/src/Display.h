@@ -0,0 +1,177 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "opencv/cv.h"
+#include "opencv/highgui.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+using namespace cv;
+
+const int DISPLAY_INTERVAL = 100; // Milliseconds between two updates of the windows (10 fps)
+
+// Shows the camera frames and the output of the threads on a separate UI thread. All
+// calls to highgui are made by this thread, so the processing loop never waits on the
+// windows and runs just as fast when nobody is watching.
+//
+// The processing side only leaves its requests in a mailbox: window changes are queued,
+// and every window has a single slot which holds the latest image. The UI thread takes
+// everything that arrived every DISPLAY_INTERVAL, older images which were never shown are
+// simply replaced.
+//
+// The camera mosaic is triple buffered: the handler converts the frames into the back
+// buffer, publishes it when complete, and the UI thread shows the last published buffer.
+// No image is copied and the UI thread never shows a half written frame.
+class Display{
+public:
+	Display() : running(false), exitrequested(false), back(0), middle(1), front(2), fresh(false) {
+	}
+
+	~Display(){
+		stop();
+	}
+
+	void start(){
+		if(running){
+			return;
+		}
+		running = true;
+		worker = thread(&Display::loop, this);
+	}
+
+	// Stop the UI thread, all windows are closed
+	void stop(){
+		if(!running){
+			return;
+		}
+		running = false;
+		worker.join();
+	}
+
+	// True when a key was pressed in one of the windows
+	bool exitRequested(){
+		return exitrequested;
+	}
+
+	// Open a window with the given size and position
+	void openWindow(const char* name, int width, int height, int x, int y){
+		WindowRequest request = { name, true, width, height, x, y };
+		lock_guard<mutex> lock(mailbox_mutex);
+		requests.push_back(request);
+	}
+
+	void closeWindow(const char* name){
+		WindowRequest request = { name, false, 0, 0, 0, 0 };
+		lock_guard<mutex> lock(mailbox_mutex);
+		requests.push_back(request);
+		images.erase(name);
+	}
+
+	// Show an image in a window. The image is shared, so it must not be changed afterwards.
+	void show(const char* name, const Mat& image){
+		lock_guard<mutex> lock(mailbox_mutex);
+		images[name] = image;
+	}
+
+	// True when the display is running and has taken the last published mosaic, so a new one
+	// would be shown. Otherwise there is no need to make one.
+	bool wantsMosaic(){
+		lock_guard<mutex> lock(mailbox_mutex);
+		return running && !fresh;
+	}
+
+	// The buffer the next mosaic has to be written to
+	Mat& mosaic(){
+		return buffers[back];
+	}
+
+	// Show the mosaic which was written to the back buffer in the given window
+	void publishMosaic(const char* name){
+		lock_guard<mutex> lock(mailbox_mutex);
+		swap(back, middle);
+		mosaicwindow = name;
+		fresh = true;
+	}
+
+private:
+	struct WindowRequest {
+		string name;
+		bool open;
+		int width, height, x, y;
+	};
+
+	thread worker;
+	atomic<bool> running;
+	atomic<bool> exitrequested;
+
+	mutex mailbox_mutex;
+	vector<WindowRequest> requests;
+	map<string, Mat> images;
+
+	// Triple buffer of the mosaic, the indices are protected by the mailbox mutex except
+	// back, which is only used by the handler thread, and front, which is only used by the UI thread.
+	Mat buffers[3];
+	int back, middle, front;
+	bool fresh; // The middle buffer holds a mosaic which wasn't shown yet
+	string mosaicwindow;
+
+	void loop(){
+		chrono::steady_clock::time_point next = chrono::steady_clock::now();
+		while(running){
+			vector<WindowRequest> pending;
+			map<string, Mat> shown;
+			string window;
+			{
+				lock_guard<mutex> lock(mailbox_mutex);
+				pending.swap(requests);
+				shown.swap(images);
+				if(fresh){
+					swap(front, middle);
+					fresh = false;
+					window = mosaicwindow;
+				}
+			}
+
+			for(int i = 0; i < pending.size(); i++){
+				const WindowRequest& request = pending[i];
+				if(request.open){
+					namedWindow(request.name, CV_WINDOW_KEEPRATIO);
+					resizeWindow(request.name, request.width, request.height);
+					moveWindow(request.name, request.x, request.y);
+				} else {
+					destroyWindow(request.name);
+				}
+			}
+
+			if(!window.empty()){
+				imshow(window, buffers[front]);
+			}
+			for(map<string, Mat>::iterator it = shown.begin(); it != shown.end(); it++){
+				imshow(it->first, it->second);
+			}
+
+			// waitKey also lets highgui handle the events of the windows
+			if(waitKey(1) >= 0){
+				exitrequested = true;
+			}
+
+			// When the windows took longer than the interval, don't try to catch up
+			next += chrono::milliseconds(DISPLAY_INTERVAL);
+			chrono::steady_clock::time_point now = chrono::steady_clock::now();
+			if(next < now){
+				next = now;
+			}
+			this_thread::sleep_until(next);
+		}
+
+		destroyAllWindows();
+	}
+};
+
+#endif
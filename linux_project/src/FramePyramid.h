@@ -0,0 +1,66 @@
+#ifndef FRAMEPYRAMID_H
+#define FRAMEPYRAMID_H
+
+#include "opencv/cv.h"
+#include <mutex>
+
+using namespace cv;
+
+const int PYRAMID_LEVELS = 3; // Full, half and quarter resolution
+
+// Image pyramid of one camera frame. Level 0 is the full resolution frame, every
+// next level has half the width and height of the previous one. The frame is
+// copied once per tick, the smaller levels are only computed when a detector
+// asks for them, and then shared by all the detectors using that level.
+//
+// The base level is the level of the frame given to update. When the frame
+// already has a lower resolution, the levels below the base can't be produced
+// and the base is returned instead; use getLevel to know which level you get.
+class FramePyramid{
+public:
+	FramePyramid() : base_level(0), valid(0) {
+	}
+
+	// Replace the frame of the pyramid. The frame is copied, the other levels are computed on request.
+	void update(const Mat& frame, int level = 0){
+		std::lock_guard<std::mutex> lock(pyramid_mutex);
+		base_level = min(max(level, 0), PYRAMID_LEVELS - 1);
+		frame.copyTo(levels[base_level]);
+		valid = 1 << base_level;
+	}
+
+	// Returns the level that will be returned when the requested level is asked
+	int getLevel(int requested){
+		std::lock_guard<std::mutex> lock(pyramid_mutex);
+		return clamp(requested);
+	}
+
+	// Returns the frame at the given level. The frame is shared, don't modify it.
+	Mat get(int level){
+		std::lock_guard<std::mutex> lock(pyramid_mutex);
+		level = clamp(level);
+		if(!(valid & (1 << base_level))){
+			return Mat();
+		}
+
+		for(int i = base_level + 1; i <= level; i++){
+			if(!(valid & (1 << i))){
+				pyrDown(levels[i - 1], levels[i]);
+				valid |= 1 << i;
+			}
+		}
+		return levels[level];
+	}
+
+private:
+	Mat levels[PYRAMID_LEVELS];
+	int base_level;
+	int valid; // Bit of every level that is computed for the current frame
+	std::mutex pyramid_mutex;
+
+	int clamp(int level){
+		return min(max(level, base_level), PYRAMID_LEVELS - 1);
+	}
+};
+
+#endif
@@ -2,26 +2,43 @@
 #define ICoffeeMakerHandler_H
 
 #include "opencv/cv.h";
+#include "DetectorResult.h"
 
 using namespace cv;
 
+// The camera's of the machine
+enum Camera {
+	CAMERA_TOP = 0,
+	CAMERA_SIDE1,
+	CAMERA_SIDE2,
+	CAMERA_COUNT
+};
+
 // This interface defines some functions implemented in the CoffeeMakerHandler class. 
+// The threads return their result together with a confidence between 0 and 1, which
+// tells how sure the detection algorithm is about the result.
+// The debug images are only made when isDebugging returns true, otherwise they are empty.
 class ICoffeeMakerHandler{
 public: 
-	virtual void CoffeeCanThreadEnded(bool hascoffeecan, Mat side_cam) = 0;
-	virtual void CoffeeCanThreadEnded(bool hascoffeecan, Mat left_cam, Mat right_cam) = 0;
-	virtual void CoffeeFilterHolderThreadEnded(bool hascoffeefilterholder, Mat top_cam) = 0;
-	virtual void CoffeeFilterThreadEnded(bool hascoffeefilter, Mat top_cam) = 0;
-	virtual void CoffeeThreadEnded(bool hascoffee, Mat top_cam) = 0;
-	virtual void MachineRunningThreadEnded(bool machinerunning, Mat top_cam) = 0;
-	virtual void MachineOnThreadEnded(bool machineon, Mat top_cam) = 0;
-	virtual void ReservoirOpenedThreadEnded(bool reservoiropen, Mat top_cam) = 0;
-	virtual void WaterThreadEnded(bool haswater, Mat side_cam) = 0;
-	virtual void WaterThreadEnded(bool haswater, Mat left_cam, Mat right_cam) = 0;
-	virtual Mat getTopFrame() = 0;
+	// Return the result of a thread to the handler. Can be called by several threads at
+	// the same time, the results are processed by the handler thread.
+	virtual void post(const DetectorResult& result) = 0;
+
+	// True when the threads have to draw their debug images during the current tick
+	virtual bool isDebugging() = 0;
+
+	// The frames are requested at a pyramid level: 0 is full resolution, 1 half resolution, ...
+	// getLevel returns the level that is really used for a requested level, the position and
+	// all distances in pixels have to be scaled to that level.
+	virtual int getLevel(int requested) = 0;
+	virtual Mat getTopFrame(int level = 0) = 0;
 	virtual int getSideFrameCount() = 0;
-	virtual Mat getSideFrame(bool second = false) = 0;
-	virtual CoffeeMakerPosition getPosition()=0;
+	virtual Mat getSideFrame(bool second = false, int level = 0) = 0;
+	virtual CoffeeMakerPosition getPosition(int level = 0)=0;
+
+	// Returns one of the color masks (ColorMask) of a camera at the given level. The masks are
+	// shared by all threads during the tick, don't modify them.
+	virtual Mat getMask(int camera, int mask, int level) = 0;
 };
 
 #endif
\ No newline at end of file
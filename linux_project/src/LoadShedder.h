@@ -0,0 +1,153 @@
+#ifndef LOADSHEDDER_H
+#define LOADSHEDDER_H
+
+#include "DetectorRegistry.h"
+#include "Logger.h"
+#include <thread>
+#include <chrono>
+#include <sstream>
+
+const double TICK_BUDGET_SHARE = 0.75; // Part of the processor time of a tick the detectors may use
+const double COST_SMOOTHING = 0.2; // Weight of a new measurement in the estimated cost of a detector
+const int SHED_REPORT_INTERVAL = 60000; // Milliseconds between two load shedding reports
+
+// Chooses the detectors of a tick within the time budget of the tick, so an overloaded box
+// still runs the detectors which matter most instead of delaying all of them.
+//
+// The budget is the processor time of one tick period on all cores, minus some room for the
+// rest of the program. The cost of every detector is estimated from how long it ran during the
+// previous ticks. The detectors are added by priority, and within a priority the one which ran
+// longest ago goes first, so skipped detectors take turns. Safety detectors always run. When a
+// detector doesn't fit, it runs one pyramid level smaller (a quarter of the cost) when it allows
+// that, otherwise it's skipped (shed). The number of skipped and downscaled runs is reported.
+//
+// A detector runs on one core, so besides the total it has to fit in the period on its own.
+// A detector which is slower than a tick even when downscaled runs over into the next ticks:
+// it's charged one core for the tick it starts in, the next ticks skip it while it still runs
+// and have its core less in their budget.
+class LoadShedder{
+public:
+	LoadShedder() : cores(max(1u, std::thread::hardware_concurrency())), reportstart(std::chrono::steady_clock::now()) {
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			cost[i] = 0;
+			lastrun[i] = 0;
+			shed[i] = 0;
+			downscaled[i] = 0;
+			overran[i] = 0;
+		}
+	}
+
+	// A detector ran for the given microseconds at levelshift levels below its own level
+	void measured(int detector, long long microseconds, int levelshift){
+		double full = microseconds / 1000.0 * (1 << (2 * levelshift)); // Cost at its own level
+		if(cost[detector] == 0){
+			cost[detector] = full;
+		} else {
+			cost[detector] += (full - cost[detector]) * COST_SMOOTHING;
+		}
+	}
+
+	// Returns the plan with the detectors of the due plan which fit in a tick of period milliseconds.
+	// running has the bit (1 << index) of every detector which still runs from an earlier tick.
+	DetectorPlan select(const DetectorPlan& due, long tick, int period, int sidecameras, unsigned int running){
+		int order[DETECTOR_COUNT];
+		for(int i = 0; i < due.count; i++){
+			// Insert in order of priority, then of the last run
+			int detector = due.detectors[i];
+			int j = i;
+			while(j > 0 && before(detector, order[j - 1])){
+				order[j] = order[j - 1];
+				j--;
+			}
+			order[j] = detector;
+		}
+
+		// Every detector which still runs takes one core of this tick
+		int busy = 0;
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			busy += (running >> i) & 1;
+		}
+		double limit = period * TICK_BUDGET_SHARE; // Time of one core during the tick
+		double budget = max(0, (int)cores - busy) * limit;
+		double spent = 0;
+		DetectorPlan plan = DetectorRegistry::empty();
+		for(int i = 0; i < due.count; i++){
+			int detector = order[i];
+			if(running & (1u << detector)){
+				overran[detector]++;
+				continue;
+			}
+
+			const DetectorInfo& info = detector_registry[detector];
+			double full = cost[detector];
+			double small = cost[detector] / 4;
+			if(info.priority == PRIORITY_SAFETY){
+				DetectorRegistry::add(plan, detector, 0, sidecameras);
+				spent += min(full, limit);
+			} else if(full <= limit && spent + full <= budget){
+				DetectorRegistry::add(plan, detector, 0, sidecameras);
+				spent += full;
+			} else if(info.downscale && small <= limit && spent + small <= budget){
+				DetectorRegistry::add(plan, detector, 1, sidecameras);
+				spent += small;
+				downscaled[detector]++;
+			} else if(full > limit && spent + limit <= budget){
+				// Too slow for one tick, it takes a core of the next ticks too
+				int shift = info.downscale? 1 : 0;
+				DetectorRegistry::add(plan, detector, shift, sidecameras);
+				spent += limit;
+				downscaled[detector] += shift;
+			} else {
+				shed[detector]++;
+				continue;
+			}
+			lastrun[detector] = tick;
+		}
+
+		report();
+		return plan;
+	}
+
+private:
+	unsigned int cores;
+	double cost[DETECTOR_COUNT]; // Estimated milliseconds at the detector's own level, 0 when unknown
+	long lastrun[DETECTOR_COUNT]; // Tick of the last run
+
+	std::chrono::steady_clock::time_point reportstart;
+	long shed[DETECTOR_COUNT]; // Runs skipped since the last report
+	long downscaled[DETECTOR_COUNT]; // Runs downscaled since the last report
+	long overran[DETECTOR_COUNT]; // Runs skipped because the previous run wasn't done, since the last report
+
+	bool before(int detector, int other){
+		DetectorPriority priority = detector_registry[detector].priority;
+		DetectorPriority otherpriority = detector_registry[other].priority;
+		if(priority != otherpriority){
+			return priority < otherpriority;
+		}
+		return lastrun[detector] < lastrun[other];
+	}
+
+	// Report the skipped and downscaled runs, when there were any
+	void report(){
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now - reportstart < std::chrono::milliseconds(SHED_REPORT_INTERVAL)){
+			return;
+		}
+		reportstart = now;
+
+		std::stringstream message;
+		for(int i = 0; i < DETECTOR_COUNT; i++){
+			if(shed[i] != 0 || downscaled[i] != 0 || overran[i] != 0){
+				message << ((message.tellp() > 0)? ", " : "") << detector_registry[i].name << ": " << shed[i] << " skipped, " << downscaled[i] << " downscaled, " << overran[i] << " still running";
+			}
+			shed[i] = 0;
+			downscaled[i] = 0;
+			overran[i] = 0;
+		}
+		if(message.tellp() > 0){
+			Logger::v("Overloaded, detector runs of the last minute: " + message.str());
+		}
+	}
+};
+
+#endif
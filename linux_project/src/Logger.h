@@ -4,6 +4,14 @@
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "RingBuffer.h"
 
 using namespace std;
 
@@ -11,53 +19,344 @@ using namespace std;
 // When the logger is set to VERBOSE then all the output will be printed.
 // Otherwise, only alarm, error and state functions will be printed.
 // Set verbose to true in the main class, to retrieve all output!
+//
+// The calling thread only puts the message in a lock-free queue. A background
+// thread formats the messages and writes them in batches, so the detection
+// threads never wait on the console. When the queue is full verbose messages
+// are dropped and the number of dropped messages is reported. After shutdown
+// the messages are written directly by the calling thread.
+// Optionally every message is also written as a JSON line to a log file,
+// which is rotated when it becomes too big.
 
 namespace Logger
 {
 	static bool verbose = true;
 
-	static string timestamp(){
-		time_t now = time(NULL);
-		struct tm * ptm = localtime(&now);
-		char buffer[32];
+	const size_t LOG_QUEUE_SIZE = 4096; // Number of messages that can be waiting, must be a power of 2
+	const size_t LOG_TEXT_SIZE = 232; // Longer messages are truncated
+	const int LOG_FLUSH_INTERVAL = 20; // Milliseconds between two batches
+	const long LOG_JSON_MAX_BYTES = 10 * 1024 * 1024; // Size at which the JSON log file is rotated
+	const int LOG_JSON_FILES = 5; // Number of rotated JSON log files that are kept
 
-		strftime (buffer, 16, "%H:%M:%S", ptm);
+	enum Level { LEVEL_MESSAGE, LEVEL_INFO, LEVEL_ALARM, LEVEL_ERROR, LEVEL_STATE };
 
-		return string("[") + buffer +string("]");
+	struct Record {
+		Level level;
+		bool addtimestamp;
+		long long time; // Milliseconds since the epoch
+		char text[LOG_TEXT_SIZE];
+	};
+
+	// Background writer thread and the queue it drains
+	class Writer {
+	public:
+		Writer() : running(true), pushed(0), written(0), dropped(0), jsonfile(0), jsonsize(0), cachedsecond(-1) {
+			worker = thread(&Writer::loop, this);
+		}
+
+		~Writer(){
+			stop();
+		}
+
+		void push(Level level, const string& text, bool addtimestamp){
+			Record record;
+			record.level = level;
+			record.addtimestamp = addtimestamp;
+			record.time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+
+			size_t length = text.size();
+			if(length >= LOG_TEXT_SIZE){
+				length = LOG_TEXT_SIZE - 4;
+				memcpy(record.text + length, "...", 4);
+			} else {
+				record.text[length] = '\0';
+			}
+			memcpy(record.text, text.data(), length);
+
+			if(!running.load(memory_order_acquire)){
+				writeDirect(record);
+				return;
+			}
+
+			// Only verbose messages are dropped when the queue is full, the other ones
+			// wait until the writer made some room, or stopped
+			while(!queue.push(record)){
+				if(level == LEVEL_INFO){
+					dropped.fetch_add(1, memory_order_relaxed);
+					return;
+				}
+				if(!running.load(memory_order_acquire)){
+					writeDirect(record);
+					return;
+				}
+				wakeup.notify_one();
+				this_thread::yield();
+			}
+			pushed.fetch_add(1, memory_order_release);
+
+			// Alarms and errors are written immediately, the rest waits for the next batch
+			if(level == LEVEL_ALARM || level == LEVEL_ERROR){
+				wakeup.notify_one();
+			}
+		}
+
+		// Blocks until all messages which were logged before the call are written
+		void flush(){
+			unsigned long target = pushed.load(memory_order_acquire);
+			unique_lock<mutex> lock(state_mutex);
+			while(written < target && running){
+				wakeup.notify_one();
+				flushed.wait_for(lock, chrono::milliseconds(LOG_FLUSH_INTERVAL));
+			}
+		}
+
+		void stop(){
+			{
+				lock_guard<mutex> lock(state_mutex);
+				if(!running){
+					return;
+				}
+				running.store(false, memory_order_release);
+			}
+			wakeup.notify_one();
+			worker.join();
+
+			lock_guard<mutex> lock(json_mutex);
+			if(jsonfile != 0){
+				fclose(jsonfile);
+				jsonfile = 0;
+			}
+		}
+
+		bool setJsonFile(const string& path){
+			lock_guard<mutex> lock(json_mutex);
+			if(jsonfile != 0){
+				fclose(jsonfile);
+			}
+			jsonpath = path;
+			return openJsonFile();
+		}
+
+	private:
+		RingBuffer<Record, LOG_QUEUE_SIZE> queue;
+		thread worker;
+		atomic<bool> running;
+		atomic<unsigned long> pushed;
+		unsigned long written;
+		atomic<unsigned long> dropped;
+
+		mutex state_mutex;
+		condition_variable wakeup;
+		condition_variable flushed;
+
+		mutex json_mutex;
+		string jsonpath;
+		FILE* jsonfile;
+		long jsonsize;
+
+		// localtime and strftime are only called once per second
+		long long cachedsecond;
+		char cachedclock[16];
+		char cacheddate[32];
+
+		void loop(){
+			Record record;
+			for(;;){
+				unsigned long count = 0;
+				{
+					lock_guard<mutex> lock(json_mutex);
+					while(queue.pop(record)){
+						write(record);
+						count++;
+					}
+
+					unsigned long lost = dropped.exchange(0, memory_order_relaxed);
+					if(lost > 0){
+						fprintf(stdout, "[%s][ERROR]: %lu log messages were dropped\n", stamp(now()), lost);
+					}
+
+					if(count > 0 || lost > 0){
+						fflush(stdout);
+						if(jsonfile != 0){
+							fflush(jsonfile);
+						}
+					}
+				}
+
+				unique_lock<mutex> lock(state_mutex);
+				written += count;
+				flushed.notify_all();
+				if(!running){
+					if(count == 0){
+						break;
+					}
+					continue;
+				}
+				wakeup.wait_for(lock, chrono::milliseconds(LOG_FLUSH_INTERVAL));
+			}
+		}
+
+		// Used when the writer stopped, the messages which were still queued go first
+		void writeDirect(const Record& record){
+			lock_guard<mutex> lock(json_mutex);
+			Record queued;
+			while(queue.pop(queued)){
+				write(queued);
+			}
+			write(record);
+			fflush(stdout);
+			if(jsonfile != 0){
+				fflush(jsonfile);
+			}
+		}
+
+		static long long now(){
+			return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+		}
+
+		// Returns HH:MM:SS.mmm for the given time
+		const char* stamp(long long time){
+			updateCache(time);
+			static char buffer[32];
+			snprintf(buffer, sizeof(buffer), "%s.%03d", cachedclock, (int)(time % 1000));
+			return buffer;
+		}
+
+		void updateCache(long long time){
+			long long second = time / 1000;
+			if(second != cachedsecond){
+				time_t t = (time_t)second;
+				struct tm local;
+				localtime_r(&t, &local);
+				strftime(cachedclock, sizeof(cachedclock), "%H:%M:%S", &local);
+				strftime(cacheddate, sizeof(cacheddate), "%Y-%m-%dT%H:%M:%S", &local);
+				cachedsecond = second;
+			}
+		}
+
+		static const char* name(Level level){
+			switch(level){
+				case LEVEL_INFO: return "INFO";
+				case LEVEL_ALARM: return "ALARM";
+				case LEVEL_ERROR: return "ERROR";
+				case LEVEL_STATE: return "STATE";
+				default: return "MESSAGE";
+			}
+		}
+
+		void write(const Record& record){
+			if(record.level == LEVEL_MESSAGE){
+				if(record.addtimestamp){
+					fprintf(stdout, "[%s] %s\n", stamp(record.time), record.text);
+				} else {
+					fprintf(stdout, "%s\n", record.text);
+				}
+			} else {
+				fprintf(stdout, "[%s][%s]: %s\n", stamp(record.time), name(record.level), record.text);
+			}
+
+			if(jsonfile != 0){
+				writeJson(record);
+			}
+		}
+
+		void writeJson(const Record& record){
+			updateCache(record.time);
+			int length = fprintf(jsonfile, "{\"time\":\"%s.%03d\",\"level\":\"%s\",\"message\":\"", cacheddate, (int)(record.time % 1000), name(record.level));
+			for(const char* c = record.text; *c != '\0'; c++){
+				if(*c == '"' || *c == '\\'){
+					fputc('\\', jsonfile);
+					length++;
+				}
+				if((unsigned char)*c < 0x20){
+					length += fprintf(jsonfile, "\\u%04x", *c);
+				} else {
+					fputc(*c, jsonfile);
+					length++;
+				}
+			}
+			length += fprintf(jsonfile, "\"}\n");
+
+			jsonsize += length;
+			if(jsonsize >= LOG_JSON_MAX_BYTES){
+				rotate();
+			}
+		}
+
+		// The current file becomes file.1, file.1 becomes file.2, ... and the oldest one is removed
+		void rotate(){
+			fclose(jsonfile);
+			jsonfile = 0;
+
+			for(int i = LOG_JSON_FILES - 1; i >= 1; i--){
+				string from = (i == 1)? jsonpath : jsonpath + "." + to_string(i - 1);
+				string to = jsonpath + "." + to_string(i);
+				rename(from.c_str(), to.c_str());
+			}
+
+			openJsonFile();
+		}
+
+		bool openJsonFile(){
+			jsonfile = fopen(jsonpath.c_str(), "a");
+			if(jsonfile == 0){
+				return false;
+			}
+			fseek(jsonfile, 0, SEEK_END);
+			jsonsize = ftell(jsonfile);
+			return true;
+		}
+	};
+
+	static Writer& writer(){
+		static Writer instance;
+		return instance;
 	}
 
 	static void setVerbose(bool v){
 		Logger::verbose = v;
 	}
 
+	// Write every message also as a JSON line to the given file
+	static bool setJsonFile(const string& path){
+		return writer().setJsonFile(path);
+	}
+
+	// Wait until all messages are written
+	static void flush(){
+		writer().flush();
+	}
+
+	// Write the remaining messages and stop the background thread
+	static void shutdown(){
+		writer().stop();
+	}
+
 	// Function used for alarm output
 	static void a(string text){
-		cout << Logger::timestamp() << "[ALARM]: " << text << endl;
+		writer().push(LEVEL_ALARM, text, true);
 	}
 
 	// Function used for verbose output
 	static void v(string text){
 		if(Logger::verbose){
-			cout << Logger::timestamp() << "[INFO]: " << text << endl;
+			writer().push(LEVEL_INFO, text, true);
 		}
 	}
 
 	// Function used for non verbose output
 	static void i(string text, bool addtimestamp = true){
-		if(addtimestamp){
-			cout << Logger::timestamp() << " ";
-		}
-		cout <<  text << endl;
+		writer().push(LEVEL_MESSAGE, text, addtimestamp);
 	}
 
 	// Function used when an error occured
 	static void e(string text){
-		cout << Logger::timestamp() << "[ERROR]: " << text << endl;
+		writer().push(LEVEL_ERROR, text, true);
 	}
 
 	// Function used when the state of the system changes
 	static void s(string text){
-		cout << Logger::timestamp() << "[STATE]: " << text << endl;
+		writer().push(LEVEL_STATE, text, true);
 	}
 };
 
@@ -0,0 +1,88 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue which can be used by several producer threads at the
+// same time. Every cell has a sequence number which tells whether the cell is
+// free to be written or ready to be read, so producers only have to agree on
+// the next position with one compare-and-swap and never wait on each other.
+// When the queue is full, push returns false instead of blocking.
+//
+// SIZE has to be a power of 2.
+template<typename T, size_t SIZE>
+class RingBuffer
+{
+public:
+	RingBuffer() : enqueue_position(0), dequeue_position(0) {
+		static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "RingBuffer size must be a power of 2");
+		for(size_t i = 0; i < SIZE; i++){
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Add a value to the queue. Returns false when the queue is full.
+	bool push(const T& value){
+		Cell* cell;
+		size_t position = enqueue_position.load(std::memory_order_relaxed);
+		for(;;){
+			cell = &cells[position & (SIZE - 1)];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			long difference = (long)sequence - (long)position;
+			if(difference == 0){
+				if(enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+					break;
+				}
+			} else if(difference < 0){
+				return false;
+			} else {
+				position = enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->value = value;
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Take the oldest value from the queue. Returns false when the queue is empty.
+	bool pop(T& value){
+		Cell* cell;
+		size_t position = dequeue_position.load(std::memory_order_relaxed);
+		for(;;){
+			cell = &cells[position & (SIZE - 1)];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			long difference = (long)sequence - (long)(position + 1);
+			if(difference == 0){
+				if(dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+					break;
+				}
+			} else if(difference < 0){
+				return false;
+			} else {
+				position = dequeue_position.load(std::memory_order_relaxed);
+			}
+		}
+
+		value = cell->value;
+		cell->sequence.store(position + SIZE, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	Cell cells[SIZE];
+	// The positions are on separate cache lines, so producers and the consumer don't invalidate each other
+	alignas(64) std::atomic<size_t> enqueue_position;
+	alignas(64) std::atomic<size_t> dequeue_position;
+
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+};
+
+#endif
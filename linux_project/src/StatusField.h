@@ -0,0 +1,54 @@
+#ifndef STATUSFIELD_H
+#define STATUSFIELD_H
+
+#include <string>
+
+// Identifies one of the booleans of the CoffeeMakerStatus. The names are the
+// ones used in the events that are sent to the event sinks.
+enum StatusField {
+	FIELD_HASCOFFEECAN = 0,
+	FIELD_RESERVOIROPEN,
+	FIELD_MACHINERUNNING,
+	FIELD_MACHINEON,
+	FIELD_COFFEEFILTERHOLDER,
+	FIELD_HASCOFFEE,
+	FIELD_HASFILTER,
+	FIELD_HASWATER,
+	FIELD_COUNT
+};
+
+static const char* status_field_names[FIELD_COUNT] = {
+	"hascoffeecan",
+	"reservoiropen",
+	"machinerunning",
+	"machineon",
+	"coffeefilterholder",
+	"hascoffee",
+	"hasfilter",
+	"haswater"
+};
+
+// Returns the bit of a field inside a mask of fields
+inline unsigned int fieldBit(int field){
+	return 1u << field;
+}
+
+// Returns the name of a field, or an empty string for an unknown field
+static const char* statusFieldName(int field){
+	if(field < 0 || field >= FIELD_COUNT){
+		return "";
+	}
+	return status_field_names[field];
+}
+
+// Returns the field with the given name, or -1 when there is no such field
+static int statusFieldFromName(const std::string& name){
+	for(int i = 0; i < FIELD_COUNT; i++){
+		if(name == status_field_names[i]){
+			return i;
+		}
+	}
+	return -1;
+}
+
+#endif
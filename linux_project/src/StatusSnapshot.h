@@ -0,0 +1,54 @@
+#ifndef STATUSSNAPSHOT_H
+#define STATUSSNAPSHOT_H
+
+#include <atomic>
+#include <stdint.h>
+#include "StatusField.h"
+
+// A consistent view of the machine status: a mask with the bit of every
+// StatusField that is true, and a generation number which increases with
+// every change.
+struct StatusSnapshot {
+	unsigned int state;
+	unsigned int generation;
+
+	bool has(StatusField field) const {
+		return (state & fieldBit(field)) != 0;
+	}
+};
+
+// Holds the last published snapshot. The snapshot fits in one atomic word, so
+// readers never take a lock and never see half of an update. Copying the cell
+// copies the current snapshot.
+class SnapshotCell {
+public:
+	SnapshotCell() : word(0) {
+	}
+
+	SnapshotCell(const SnapshotCell& other) : word(other.word.load(std::memory_order_acquire)) {
+	}
+
+	SnapshotCell& operator=(const SnapshotCell& other){
+		word.store(other.word.load(std::memory_order_acquire), std::memory_order_release);
+		return *this;
+	}
+
+	void store(unsigned int state){
+		uint64_t current = word.load(std::memory_order_relaxed);
+		uint64_t generation = (current >> 32) + 1;
+		word.store((generation << 32) | state, std::memory_order_release);
+	}
+
+	StatusSnapshot load() const {
+		uint64_t current = word.load(std::memory_order_acquire);
+		StatusSnapshot snapshot;
+		snapshot.state = (unsigned int)(current & 0xffffffff);
+		snapshot.generation = (unsigned int)(current >> 32);
+		return snapshot;
+	}
+
+private:
+	std::atomic<uint64_t> word;
+};
+
+#endif
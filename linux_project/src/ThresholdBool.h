@@ -10,6 +10,8 @@
 // Using this kind of booleans to store the machine status booleans, false possitives
 // are filtered out, because one value doesn't necessarily change the value of the
 // threshold bool.
+//
+// The values are stored in single bytes, so thresholds can't be larger than 255.
 class ThresholdBool
 {
 public: 
@@ -25,27 +27,35 @@ public:
 	}
 
 	operator const bool() const {
-            return (double)value > (threshold /2.0);
+            return 2 * value > threshold;
         }
 
+	// Returns how sure the threshold bool is about its value, between 0.5 and 1.
+	// This is 1 when the inner value is at the threshold (for true) or at 0 (for false).
+	double getConfidence() const {
+		double filled = (double)value / threshold;
+		return (*this)? filled : 1.0 - filled;
+	}
+
 	ThresholdBool & operator = (bool v){
 		if(v){
-			value += 1;
+			if(value < threshold){
+				value += 1;
+			}
 		} else if(!v && reversable) {
-			value -= 1;
-		}
-
-		if(value > threshold){
-			value = threshold;
-		}
-
-		if(value < 0){
-			value = 0;
+			if(value > 0){
+				value -= 1;
+			}
 		}
 
 		return *this;
 	}
 
+	// The threshold bool ignores the confidence of the sample, see ConfidenceBool
+	ThresholdBool & update(bool v, float){
+		return (*this = v);
+	}
+
 	ThresholdBool & operator &= (bool v){
 		if(v){
 			value = threshold;
@@ -57,8 +67,8 @@ public:
 	}
 
 private:
-	int threshold;
-	int value;
+	unsigned char value;
+	unsigned char threshold;
 	bool reversable;
 };
 
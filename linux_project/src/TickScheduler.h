@@ -0,0 +1,100 @@
+#ifndef TICKSCHEDULER_H
+#define TICKSCHEDULER_H
+
+#include "Logger.h"
+#include <chrono>
+#include <sstream>
+
+const int TICK_REPORT_INTERVAL = 60000; // Milliseconds between two tick rate reports
+
+// Schedules a periodic event (a tick) on deadlines of the steady clock, so the period
+// doesn't depend on how long the work between two checks takes.
+//
+// A tick which is late is started as soon as possible, and the next deadline stays on
+// the original schedule (catch-up), so the average rate is kept. When a tick is late by
+// more than a whole period, the missed ticks are skipped and the schedule starts again
+// from now, so a slow moment doesn't cause a burst of ticks.
+//
+// With report set, the real number of ticks per second is reported every TICK_REPORT_INTERVAL.
+class TickScheduler{
+public:
+	typedef std::chrono::steady_clock clock;
+
+	TickScheduler(const char* name = 0) : name(name), period(0), ticks(0), skipped(0) {
+	}
+
+	// Start the schedule, the first tick is due after one period
+	void start(int milliseconds){
+		period = std::chrono::milliseconds(milliseconds);
+		last = clock::now();
+		next = last + period;
+		reportstart = last;
+		ticks = 0;
+		skipped = 0;
+	}
+
+	// Change the period, the next tick is one new period after the previous one
+	void setPeriod(int milliseconds){
+		std::chrono::milliseconds changed(milliseconds);
+		if(changed != period){
+			period = changed;
+			next = last + period;
+		}
+	}
+
+	bool due() const {
+		return clock::now() >= next;
+	}
+
+	// Deadline of the next tick
+	clock::time_point getNext() const {
+		return next;
+	}
+
+	// Called when the tick is started, returns the milliseconds since the previous tick
+	int tick(){
+		clock::time_point now = clock::now();
+		int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+		last = now;
+
+		next += period;
+		if(next <= now){
+			// More than a period late, skip the missed ticks
+			skipped += (now - next) / period + 1;
+			next = now + period;
+		}
+
+		ticks++;
+		report(now);
+		return elapsed;
+	}
+
+private:
+	const char* name; // Name used in the report, no report when 0
+	clock::duration period;
+	clock::time_point next; // Deadline of the next tick
+	clock::time_point last; // Start of the previous tick
+
+	clock::time_point reportstart;
+	long ticks; // Ticks since the last report
+	long skipped; // Ticks skipped since the last report
+
+	void report(clock::time_point now){
+		double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(now - reportstart).count() / 1000.0;
+		if(seconds * 1000 < TICK_REPORT_INTERVAL){
+			return;
+		}
+
+		if(name != 0){
+			std::stringstream message;
+			message.precision(3);
+			message << name << " rate: " << ticks / seconds << " per second, " << skipped << " late ticks skipped.";
+			Logger::v(message.str());
+		}
+		reportstart = now;
+		ticks = 0;
+		skipped = 0;
+	}
+};
+
+#endif
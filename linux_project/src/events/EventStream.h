@@ -0,0 +1,78 @@
+#ifndef EVENTSTREAM_H
+#define EVENTSTREAM_H
+
+#include "IEventSink.h"
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+// The event stream fills in the common information of every event (machine id
+// and time) and passes it to all the sinks. The stream takes ownership of the sinks.
+class EventStream{
+public:
+	EventStream() : machine("coffeemaker") {
+	}
+
+	~EventStream(){
+		for(int i = 0; i < sinks.size(); i++){
+			delete sinks[i];
+		}
+	}
+
+	void addSink(IEventSink* sink){
+		std::lock_guard<std::mutex> lock(sink_mutex);
+		sinks.push_back(sink);
+	}
+
+	bool hasSinks(){
+		std::lock_guard<std::mutex> lock(sink_mutex);
+		return !sinks.empty();
+	}
+
+	void setMachineId(const string& id){
+		std::lock_guard<std::mutex> lock(sink_mutex);
+		machine = id;
+	}
+
+	// frame is the number of the frame the change was detected in
+	void publishState(const string& name, bool value, double confidence, long frame){
+		MachineEvent event;
+		event.type = EVENT_STATE;
+		event.name = name;
+		event.value = value;
+		event.confidence = confidence;
+		event.frame = frame;
+		publish(event);
+	}
+
+	void publishAlarm(const string& name, const string& message, bool raised, double confidence, long frame){
+		MachineEvent event;
+		event.type = EVENT_ALARM;
+		event.name = name;
+		event.value = raised;
+		event.confidence = confidence;
+		event.frame = frame;
+		event.message = message;
+		publish(event);
+	}
+
+private:
+	std::vector<IEventSink*> sinks;
+	string machine;
+	std::mutex sink_mutex;
+
+	void publish(MachineEvent& event){
+		event.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+		std::lock_guard<std::mutex> lock(sink_mutex);
+		event.machine = machine;
+		for(int i = 0; i < sinks.size(); i++){
+			sinks[i]->publish(event);
+		}
+	}
+
+	EventStream(const EventStream&);
+	EventStream& operator=(const EventStream&);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef FILEEVENTSINK_H
+#define FILEEVENTSINK_H
+
+#include "IEventSink.h"
+#include <cstdio>
+
+// Appends every event as a JSON line to a file
+class FileEventSink : public IEventSink{
+public:
+	FileEventSink(const string& path) : file(fopen(path.c_str(), "a")) {
+	}
+
+	~FileEventSink(){
+		if(file != 0){
+			fclose(file);
+		}
+	}
+
+	bool isOpened(){
+		return file != 0;
+	}
+
+	virtual void publish(const MachineEvent& event){
+		if(file == 0){
+			return;
+		}
+
+		string line = event.toJson();
+		fprintf(file, "%s\n", line.c_str());
+		fflush(file);
+	}
+
+private:
+	FILE* file;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef IEventSink_H
+#define IEventSink_H
+
+#include "MachineEvent.h"
+
+// This interface is implemented by every destination of the machine events.
+// publish is called for each event, possibly from several threads, but never
+// at the same time.
+class IEventSink{
+public:
+	virtual ~IEventSink(){}
+	virtual void publish(const MachineEvent& event) = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef MACHINEEVENT_H
+#define MACHINEEVENT_H
+
+#include <string>
+#include <sstream>
+#include <cstdio>
+
+using namespace std;
+
+enum EventType {
+	EVENT_STATE, // One of the status booleans changed
+	EVENT_ALARM // An alarm was raised or cleared
+};
+
+// A machine event as it's sent to the event sinks. For state events the name is
+// the name of the status field, for alarms it's the name of the alarm.
+struct MachineEvent {
+	EventType type;
+	string machine; // Id of the machine which produced the event
+	long long time; // Milliseconds since the epoch
+	long frame; // Frame number at which the event happened
+	string name;
+	bool value; // New value of the field, or true when the alarm is raised and false when cleared
+	double confidence; // Between 0 and 1
+	string message; // Human readable description, only used for alarms
+
+	// Serialize the event as one line of JSON (without newline)
+	string toJson() const {
+		stringstream json;
+		json << "{\"type\":\"" << ((type == EVENT_STATE)? "state" : "alarm") << "\"";
+		json << ",\"machine\":\"" << escape(machine) << "\"";
+		json << ",\"time\":" << time;
+		json << ",\"frame\":" << frame;
+		json << ",\"name\":\"" << escape(name) << "\"";
+		json << ",\"value\":" << (value? "true" : "false");
+		json << ",\"confidence\":" << confidence;
+		if(type == EVENT_ALARM){
+			json << ",\"message\":\"" << escape(message) << "\"";
+		}
+		json << "}";
+		return json.str();
+	}
+
+	static string escape(const string& text){
+		string escaped;
+		for(int i = 0; i < text.size(); i++){
+			char c = text[i];
+			if(c == '"' || c == '\\'){
+				escaped += '\\';
+				escaped += c;
+			} else if((unsigned char)c < 0x20){
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+				escaped += buffer;
+			} else {
+				escaped += c;
+			}
+		}
+		return escaped;
+	}
+};
+
+#endif
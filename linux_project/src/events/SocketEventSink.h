@@ -0,0 +1,55 @@
+#ifndef SOCKETEVENTSINK_H
+#define SOCKETEVENTSINK_H
+
+#include "IEventSink.h"
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Sends every event as a JSON datagram to a Unix domain socket. Each datagram
+// contains exactly one event, so the consumer doesn't need to split a stream.
+// The consumer doesn't need to be running: when nobody is listening, or the
+// consumer can't keep up, the event is dropped instead of blocking the detection.
+class SocketEventSink : public IEventSink{
+public:
+	SocketEventSink(const string& path) : dropped(0) {
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	}
+
+	~SocketEventSink(){
+		if(fd >= 0){
+			close(fd);
+		}
+	}
+
+	bool isOpened(){
+		return fd >= 0;
+	}
+
+	// Number of events that couldn't be delivered
+	long getDropped(){
+		return dropped;
+	}
+
+	virtual void publish(const MachineEvent& event){
+		if(fd < 0){
+			return;
+		}
+
+		string json = event.toJson();
+		if(sendto(fd, json.data(), json.size(), MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr*)&address, sizeof(address)) < 0){
+			dropped++;
+		}
+	}
+
+private:
+	int fd;
+	struct sockaddr_un address;
+	long dropped;
+};
+
+#endif
@@ -3,6 +3,9 @@
 #include "opencv/highgui.h"
 
 #include "CoffeeMakerHandler.h"
+#include "events/FileEventSink.h"
+#include "events/SocketEventSink.h"
+#include "sources/FrameSources.h"
 
 using namespace std;
 using namespace cv;
@@ -10,52 +13,130 @@ using namespace cv;
 int main(int argc, char *argv[]){
 	Logger::setVerbose(false);
 
-	// Checks the command line arguments. The correct usage is: koffiedetection param1 param2 [param3]
-	// param1: The path to the TOP camera
+	// Checks the command line arguments. The correct usage is: koffiedetection [options] param1 param2 [param3]
+	// param1: The path to the TOP camera. A path like v4l2:/dev/video0 reads a V4L2 camera directly,
+	//         shm:<name> attaches to a shared frame ring written by shmframewriter or another capture process.
 	// param2: The path to the SIDE camera. This can be a view from the left or right
 	// param3: [OPTIONAL] The path to a second SIDE camera. This improves the stability of the detection algorithm. It is implied that when using a LEFT view for param2, param3 will contain a RIGHT view and vice versa.
-	if(argc == 1 || argc == 2){
-		cout << endl << "!!! Incorrect usage:\n" << "Usage: koffiedetection" << " " << "param1 param2 [param3]" << endl;
-		cout << "\tparam1: " << "The path to the TOP camera" << endl;
+	// Options start with -- and can be placed anywhere between the parameters.
+	vector<const char*> cameras;
+	const char* logfile = 0;
+	const char* machineid = 0;
+	const char* rulesfile = 0;
+	vector<const char*> eventfiles;
+	vector<const char*> eventsockets;
+	bool halfingest = false;
+	bool debug = false;
+	bool headless = false;
+	bool validoptions = true;
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if(arg == "--log-json" && i + 1 < argc){
+			logfile = argv[++i];
+		} else if(arg == "--machine-id" && i + 1 < argc){
+			machineid = argv[++i];
+		} else if(arg == "--rules" && i + 1 < argc){
+			rulesfile = argv[++i];
+		} else if(arg == "--events" && i + 1 < argc){
+			eventfiles.push_back(argv[++i]);
+		} else if(arg == "--events-socket" && i + 1 < argc){
+			eventsockets.push_back(argv[++i]);
+		} else if(arg == "--half-ingest"){
+			halfingest = true;
+		} else if(arg == "--debug"){
+			debug = true;
+		} else if(arg == "--headless"){
+			headless = true;
+		} else if(arg.compare(0, 2, "--") == 0){
+			validoptions = false;
+		} else {
+			cameras.push_back(argv[i]);
+		}
+	}
+
+	if(!validoptions || cameras.size() < 2 || cameras.size() > 3){
+		cout << endl << "!!! Incorrect usage:\n" << "Usage: koffiedetection" << " " << "[options] param1 param2 [param3]" << endl;
+		cout << "\tparam1: " << "The path to the TOP camera. Use v4l2:<device> (e.g. v4l2:/dev/video0) to read a V4L2 camera which delivers 8-bit Bayer frames directly, or shm:<name> to read the frames from a shared frame ring, for every camera." << endl;
 		cout << "\tparam2: " << "The path to the SIDE camera. This can be a view from the left or right" << endl;
 		cout << "\tparam3: [OPTIONAL]" << "The path to a second SIDE camera. This improves the stability of the detection algorithm. It is implied that when using a LEFT view for param2, param3 will contain a RIGHT view and vice versa." << endl;
+		cout << "\toptions:" << endl;
+		cout << "\t--log-json <file>: " << "Also write the log as JSON lines to this file. The file is rotated when it becomes too big." << endl;
+		cout << "\t--machine-id <id>: " << "Id of the machine, added to every event" << endl;
+		cout << "\t--rules <file>: " << "Load the alarm rules from this file instead of using the built-in rules" << endl;
+		cout << "\t--events <file>: " << "Append the state changes and alarms as JSON lines to this file" << endl;
+		cout << "\t--events-socket <path>: " << "Send the state changes and alarms as JSON datagrams to this Unix domain socket" << endl;
+		cout << "\t--debug: " << "Show the debug images of the detection threads" << endl;
+		cout << "\t--headless: " << "Don't show any windows, the program stops at the end of the camera input" << endl;
+		cout << "\t--half-ingest: " << "Convert every 2x2 block of the raw camera frames to one color pixel, the detection runs at half resolution" << endl;
 
 		return 1;
 	}
 
-	const char* cam_top;
-	const char* cam_side1;
-	const char* cam_side2;
-	if(argc==3){ // Only two camera's provided, so only one side camera is used.
-		cam_top= argv[1];
-		cam_side1 = argv[2];
-		cam_side2 = 0;
-	} else if(argc==4){ // All three camera's are provided, so there are two side camera's.
-		cam_top= argv[1];
-		cam_side1 = argv[2];
-		cam_side2 = argv[3];
+	if(logfile != 0 && !Logger::setJsonFile(logfile)){
+		Logger::e(string("Unable to open the JSON log file ") + logfile);
 	}
 
-	VideoCapture v_top, v_side1, v_side2;
+	shared_ptr<const AlarmRuleSet> alarmrules;
+	if(rulesfile != 0){
+		string error;
+		alarmrules = AlarmRuleSet::load(rulesfile, error);
+		if(!alarmrules){
+			Logger::e("Unable to load the alarm rules: " + error);
+			Logger::shutdown();
+			return 1;
+		}
+	}
 
-	// Open the camera sources
-	v_top.open(cam_top);
-	v_side1.open(cam_side1);
-	if(cam_side2 != 0){
-		v_side2.open(cam_side2);
+	// Create the destinations of the machine events
+	EventStream events;
+	if(machineid != 0){
+		events.setMachineId(machineid);
+	}
+	for(int i = 0; i < eventfiles.size(); i++){
+		FileEventSink* sink = new FileEventSink(eventfiles[i]);
+		if(!sink->isOpened()){
+			Logger::e(string("Unable to open the event file ") + eventfiles[i]);
+		}
+		events.addSink(sink);
 	}
+	for(int i = 0; i < eventsockets.size(); i++){
+		SocketEventSink* sink = new SocketEventSink(eventsockets[i]);
+		if(!sink->isOpened()){
+			Logger::e(string("Unable to create the event socket for ") + eventsockets[i]);
+		}
+		events.addSink(sink);
+	}
+
+	const char* cam_top = cameras[0];
+	const char* cam_side1 = cameras[1];
+	const char* cam_side2 = (cameras.size() == 3)? cameras[2] : 0; // With only two camera's, only one side camera is used.
+
+	// Open the camera sources. Video files are decoded ahead on their own thread.
+	unique_ptr<IFrameSource> v_top(openFrameSource(cam_top));
+	unique_ptr<IFrameSource> v_side1(openFrameSource(cam_side1));
+	unique_ptr<IFrameSource> v_side2((cam_side2 != 0)? openFrameSource(cam_side2) : 0);
 
 	// Exit when not all camera's can be opened (e.g. wrong path to file) otherwise initiate the detection program
-	if(!v_top.isOpened() || !v_side1.isOpened() || (cam_side2 != 0 && !v_side2.isOpened()) )
+	if(!v_top->isOpened() || !v_side1->isOpened() || (cam_side2 != 0 && !v_side2->isOpened()) )
 	{
 		Logger::e("Unable to open all video streams..., please check the filename and try again.");
+		Logger::shutdown();
 
 		return 1;
 	} else{ 
 		try{
 			// The CoffeeMakerHandler takes care of all the detection algorithms and will automatically exit at the
 			// end of the camere input.
-			CoffeeMakerHandler handler(&v_top, &v_side1, (cam_side2 != 0 )? &v_side2 : 0);
+			CoffeeMakerHandler handler(v_top.get(), v_side1.get(), v_side2.get());
+			if(events.hasSinks()){
+				handler.setEventStream(&events);
+			}
+			if(alarmrules){
+				handler.setAlarmRules(alarmrules);
+			}
+			handler.setHalfIngest(halfingest);
+			handler.setDebug(debug);
+			handler.setHeadless(headless);
 			if(handler.initialize()){
 				handler.run();
 			} else {
@@ -67,7 +148,7 @@ int main(int argc, char *argv[]){
 			cout << error << endl;
 		}
 
-		destroyAllWindows();
+		Logger::shutdown();
 
 		return 0;
 	}
@@ -0,0 +1,38 @@
+#ifndef CAPTUREFRAMESOURCE_H
+#define CAPTUREFRAMESOURCE_H
+
+#include "IFrameSource.h"
+#include "opencv/highgui.h"
+#include <string>
+
+// Reads the frames of a camera or a video file with a VideoCapture. With the FFmpeg
+// backend grab already decodes the frame of a video file, retrieve only converts it to
+// BGR into a new image. A frame which isn't used saves that conversion and copy, not
+// the decoding. The time of the grab is used as capture time.
+class CaptureFrameSource : public IFrameSource{
+public:
+	CaptureFrameSource(const std::string& path) : grabtime(0) {
+		capture.open(path);
+	}
+
+	virtual bool isOpened(){
+		return capture.isOpened();
+	}
+
+	virtual bool grab(){
+		grabtime = steadyMicroseconds();
+		return capture.grab();
+	}
+
+	virtual bool retrieve(SourceFrame& frame){
+		frame.buffer.reset();
+		frame.timestamp = grabtime;
+		return capture.retrieve(frame.image) && !frame.image.empty();
+	}
+
+private:
+	VideoCapture capture;
+	long long grabtime;
+};
+
+#endif
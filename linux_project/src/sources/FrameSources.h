@@ -0,0 +1,33 @@
+#ifndef FRAMESOURCES_H
+#define FRAMESOURCES_H
+
+#include "IFrameSource.h"
+#include "CaptureFrameSource.h"
+#include "ReadAheadFrameSource.h"
+#include "V4L2FrameSource.h"
+#include "SharedFrameSource.h"
+#include <sys/stat.h>
+#include <string.h>
+
+// Opens the right source for a camera path given on the command line. Video files
+// are decoded ahead on their own thread, which also converts the frames that won't be
+// used (see ReadAheadFrameSource), camera's are read when the frames are used
+// (reading a live camera ahead would only make the frames older). A path starting
+// with v4l2: is a V4L2 device which is read directly, without a copy of the frames.
+// A path starting with shm: is a shared frame ring written by another process.
+inline IFrameSource* openFrameSource(const char* path){
+	if(strncmp(path, "v4l2:", 5) == 0){
+		return new V4L2FrameSource(path + 5);
+	}
+	if(strncmp(path, "shm:", 4) == 0){
+		return new SharedFrameSource(path + 4);
+	}
+
+	struct stat info;
+	if(stat(path, &info) == 0 && S_ISREG(info.st_mode)){
+		return new ReadAheadFrameSource(path);
+	}
+	return new CaptureFrameSource(path);
+}
+
+#endif
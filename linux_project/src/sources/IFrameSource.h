@@ -0,0 +1,55 @@
+#ifndef IFrameSource_H
+#define IFrameSource_H
+
+#include "opencv/cv.h"
+#include <memory>
+#include <chrono>
+
+using namespace cv;
+
+// A retrieved frame. The image can point into a buffer of the source (e.g. a buffer
+// of the camera driver), which is given back to the source when the last copy of the
+// frame is released. Release frames as soon as possible, the source only has a few buffers.
+struct SourceFrame {
+	Mat image;
+	std::shared_ptr<void> buffer; // Holds the buffer of the image, empty when the image owns its data
+	long long timestamp; // Capture time in microseconds of the steady clock, 0 when unknown
+
+	SourceFrame() : timestamp(0) {
+	}
+
+	void release(){
+		image.release();
+		buffer.reset();
+	}
+};
+
+// Current time in microseconds of the steady clock, the clock of the capture timestamps
+inline long long steadyMicroseconds(){
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// This interface is implemented by every source of camera frames.
+// Reading a frame is split in two steps: grab moves the source to the next frame,
+// and retrieve makes an image of the grabbed frame. What each step costs depends on
+// the source (see the implementations). The handler grabs all the camera's every frame
+// to keep them in sync, but only retrieves the frames it uses.
+class IFrameSource{
+public:
+	virtual ~IFrameSource(){}
+
+	virtual bool isOpened() = 0;
+
+	// Move to the next frame. Returns false at the end of the input.
+	virtual bool grab() = 0;
+
+	// Return the image of the last grabbed frame. Can be called once per grab.
+	virtual bool retrieve(SourceFrame& frame) = 0;
+
+	// Grab and retrieve the next frame
+	bool read(SourceFrame& frame){
+		return grab() && retrieve(frame);
+	}
+};
+
+#endif
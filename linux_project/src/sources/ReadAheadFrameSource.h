@@ -0,0 +1,115 @@
+#ifndef READAHEADFRAMESOURCE_H
+#define READAHEADFRAMESOURCE_H
+
+#include "IFrameSource.h"
+#include "opencv/highgui.h"
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+const int READAHEAD_FRAMES = 8; // Number of frames decoded ahead of the handler
+
+// Reads a video file on its own decoder thread. The decoder runs ahead of the handler
+// and keeps up to READAHEAD_FRAMES decoded frames in a queue, so the handler only takes
+// the next frame instead of waiting for the decoding. Every file has its own decoder,
+// so the files of the three camera's are decoded at the same time.
+//
+// The decoder thread reads (grabs and retrieves) every frame, because a VideoCapture
+// can only retrieve the frame it grabbed last and the decoder doesn't know which frames
+// the handler will use. So unlike CaptureFrameSource, an unused frame still costs its
+// colour conversion and copy, only on another core. That's the trade-off: the handler
+// thread never waits on the decoding, but files use more processor time in total.
+// grab and retrieve both come from the queue. When the queue is full the decoder waits,
+// a file is never read faster than it's used.
+class ReadAheadFrameSource : public IFrameSource{
+public:
+	ReadAheadFrameSource(const std::string& path) : opened(false), running(false), ended(false) {
+		capture.open(path);
+		opened = capture.isOpened();
+		if(opened){
+			running = true;
+			worker = std::thread(&ReadAheadFrameSource::loop, this);
+		}
+	}
+
+	~ReadAheadFrameSource(){
+		if(running){
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex);
+				running = false;
+			}
+			space.notify_one();
+			worker.join();
+		}
+	}
+
+	virtual bool isOpened(){
+		return opened;
+	}
+
+	// Take the next decoded frame, waits when the decoder is behind
+	virtual bool grab(){
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		while(frames.empty() && !ended){
+			available.wait(lock);
+		}
+		if(frames.empty()){
+			current.release();
+			return false;
+		}
+
+		current = frames.front();
+		frames.pop_front();
+		space.notify_one();
+		return true;
+	}
+
+	// Files have no capture time, the timestamp is 0
+	virtual bool retrieve(SourceFrame& frame){
+		frame.image = current;
+		frame.buffer.reset();
+		frame.timestamp = 0;
+		current.release();
+		return !frame.image.empty();
+	}
+
+private:
+	VideoCapture capture; // Only used by the decoder thread once it's started
+	bool opened; // Whether the capture could be opened, so isOpened doesn't touch the capture
+	std::thread worker;
+	bool running, ended; // Protected by the queue mutex
+
+	std::mutex queue_mutex;
+	std::condition_variable available; // A frame was added or the file ended
+	std::condition_variable space; // A frame was taken or the source is stopped
+	std::deque<Mat> frames;
+	Mat current; // The grabbed frame, only used by the handler thread
+
+	void loop(){
+		for(;;){
+			// Every frame gets a new buffer, the queue and the handler share them
+			Mat frame;
+			if(!capture.read(frame) || frame.empty()){
+				break;
+			}
+
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			while(running && frames.size() >= READAHEAD_FRAMES){
+				space.wait(lock);
+			}
+			if(!running){
+				return;
+			}
+			frames.push_back(frame);
+			available.notify_one();
+		}
+
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		ended = true;
+		available.notify_one();
+	}
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef SHAREDFRAMERING_H
+#define SHAREDFRAMERING_H
+
+#include "opencv/cv.h"
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace cv;
+
+/*
+	Ring of raw camera frames in POSIX shared memory. One capture process writes the
+	frames of a camera into the ring, and any number of processes (detection, recording,
+	debugging) read them without copying. Every camera has its own ring.
+
+	The memory starts with a SharedFrameRingHeader, followed by the slots. Every slot is a
+	SharedFrameSlot followed by the image data. The writer puts every frame in the next
+	slot which no reader holds, so a frame a reader is using is never overwritten. The
+	readers always take the newest frame.
+
+	A slot is claimed with two counters: the writer makes the sequence odd and then checks
+	that there are no readers, a reader adds itself to the readers and then checks that the
+	sequence is even. Both use sequentially consistent operations, so they can't both succeed.
+	A reader which crashes while holding a slot keeps that slot, the writer uses the others.
+*/
+
+const uint32_t SHM_RING_MAGIC = 0x4b464d31; // Set when the ring is ready
+const int SHM_RING_SLOTS = 8; // Default number of slots
+const int SHM_RING_ALIGN = 64; // Alignment of the headers and the image data
+
+struct SharedFrameRingHeader {
+	std::atomic<uint32_t> magic;
+	uint32_t slots;
+	uint64_t slotsize; // Bytes of image data per slot
+	std::atomic<uint64_t> published; // Number of frames written
+	std::atomic<uint32_t> latest; // Slot with the newest frame
+	std::atomic<uint32_t> closed; // Set when the writer stopped
+};
+
+struct SharedFrameSlot {
+	std::atomic<uint64_t> sequence; // 2 * frame number (from 1) when the slot holds a frame, odd while it's written
+	std::atomic<uint32_t> readers; // Number of readers holding the frame
+	int64_t timestamp; // Capture time in microseconds of the steady clock, 0 when unknown
+	int32_t width, height, type, step; // Format of the image, type is an OpenCV type (e.g. CV_8UC1)
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "The shared frame ring needs lock-free atomics");
+
+class SharedFrameRing{
+public:
+	static size_t align(size_t size){
+		return (size + SHM_RING_ALIGN - 1) / SHM_RING_ALIGN * SHM_RING_ALIGN;
+	}
+
+	static size_t slotStride(uint64_t slotsize){
+		return align(sizeof(SharedFrameSlot)) + align(slotsize);
+	}
+
+	static size_t totalSize(uint32_t slots, uint64_t slotsize){
+		return align(sizeof(SharedFrameRingHeader)) + slots * slotStride(slotsize);
+	}
+
+	static SharedFrameSlot* slot(void* memory, int index){
+		SharedFrameRingHeader* header = (SharedFrameRingHeader*)memory;
+		return (SharedFrameSlot*)((char*)memory + align(sizeof(SharedFrameRingHeader)) + index * slotStride(header->slotsize));
+	}
+
+	static uchar* data(SharedFrameSlot* slot){
+		return (uchar*)slot + align(sizeof(SharedFrameSlot));
+	}
+
+	// Names of shared memory objects start with a /
+	static std::string objectName(const std::string& name){
+		return (!name.empty() && name[0] == '/')? name : "/" + name;
+	}
+};
+
+// Writes frames into a new ring. The ring is made for the size of the first frame, larger
+// frames are refused. The ring is removed when the writer is destroyed, readers which are
+// still attached keep their mapping and see that the writer stopped.
+class SharedFrameWriter{
+public:
+	SharedFrameWriter(const std::string& name, int slots = SHM_RING_SLOTS)
+		: name(SharedFrameRing::objectName(name)), slots(slots), memory(0), size(0), next(0), frames(0), dropped(0) {
+	}
+
+	~SharedFrameWriter(){
+		if(memory != 0){
+			header()->closed.store(1);
+			munmap(memory, size);
+			shm_unlink(name.c_str());
+		}
+	}
+
+	// Write a frame. Returns false when it doesn't fit or every slot is held by a reader.
+	bool write(const Mat& frame, long long timestamp){
+		size_t bytes = frame.cols * frame.elemSize();
+		if(memory == 0 && !create(bytes * frame.rows)){
+			return false;
+		}
+		if(bytes * frame.rows > header()->slotsize){
+			dropped++;
+			return false;
+		}
+
+		for(int i = 0; i < slots; i++){
+			int index = (next + i) % slots;
+			SharedFrameSlot* slot = SharedFrameRing::slot(memory, index);
+
+			// Claim the slot, unless a reader holds it
+			uint64_t sequence = slot->sequence.load();
+			slot->sequence.store(sequence | 1);
+			if(slot->readers.load() != 0){
+				slot->sequence.store(sequence);
+				continue;
+			}
+
+			uchar* target = SharedFrameRing::data(slot);
+			for(int y = 0; y < frame.rows; y++){
+				memcpy(target + y * bytes, frame.ptr<uchar>(y), bytes);
+			}
+			slot->timestamp = timestamp;
+			slot->width = frame.cols;
+			slot->height = frame.rows;
+			slot->type = frame.type();
+			slot->step = bytes;
+
+			frames++;
+			slot->sequence.store(2 * frames);
+			header()->latest.store(index);
+			header()->published.store(frames);
+			next = index + 1;
+			return true;
+		}
+
+		dropped++;
+		return false;
+	}
+
+	// Number of frames which couldn't be written
+	long long getDropped(){
+		return dropped;
+	}
+
+private:
+	std::string name;
+	int slots;
+	void* memory;
+	size_t size;
+	int next; // Slot to try first for the next frame
+	uint64_t frames; // Frames written
+	long long dropped;
+
+	SharedFrameRingHeader* header(){
+		return (SharedFrameRingHeader*)memory;
+	}
+
+	bool create(uint64_t slotsize){
+		shm_unlink(name.c_str()); // Remove the ring of a previous writer
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if(fd < 0){
+			return false;
+		}
+
+		size = SharedFrameRing::totalSize(slots, slotsize);
+		if(ftruncate(fd, size) < 0){
+			close(fd);
+			return false;
+		}
+		void* mapped = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(mapped == MAP_FAILED){
+			return false;
+		}
+
+		// The new memory is zero, only the sizes and the magic have to be set
+		memory = mapped;
+		header()->slots = slots;
+		header()->slotsize = slotsize;
+		header()->magic.store(SHM_RING_MAGIC);
+		return true;
+	}
+};
+
+#endif
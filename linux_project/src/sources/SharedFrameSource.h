@@ -0,0 +1,131 @@
+#ifndef SHAREDFRAMESOURCE_H
+#define SHAREDFRAMESOURCE_H
+
+#include "IFrameSource.h"
+#include "SharedFrameRing.h"
+#include "../Logger.h"
+#include <string>
+#include <thread>
+#include <chrono>
+
+const int SHM_TIMEOUT = 2000; // Milliseconds to wait for a new frame before the writer is considered gone
+
+// Reads the frames a capture process writes into a shared frame ring (see SharedFrameRing).
+// A retrieved frame points into the slot of the ring, which the writer doesn't use again
+// until the last copy of the frame is released. grab always takes the newest frame, frames
+// written in between are skipped. The input ends when the writer stops.
+class SharedFrameSource : public IFrameSource{
+public:
+	SharedFrameSource(const std::string& name) : memory(0), size(0), lastframe(0), grabbed(0) {
+		std::string object = SharedFrameRing::objectName(name);
+		int fd = shm_open(object.c_str(), O_RDWR, 0);
+		if(fd < 0){
+			Logger::e("Unable to open the shared frame ring " + object + ", is the writer running?");
+			return;
+		}
+
+		struct stat info;
+		if(fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(SharedFrameRingHeader)){
+			size = info.st_size;
+			memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if(memory == MAP_FAILED){
+				memory = 0;
+			}
+		}
+		close(fd);
+
+		if(memory == 0 || header()->magic.load() != SHM_RING_MAGIC || SharedFrameRing::totalSize(header()->slots, header()->slotsize) > size){
+			Logger::e(object + " is not a shared frame ring.");
+			detach();
+		}
+	}
+
+	~SharedFrameSource(){
+		detach();
+	}
+
+	virtual bool isOpened(){
+		return memory != 0;
+	}
+
+	// Take the newest frame, waits until the writer wrote a frame which wasn't taken yet
+	virtual bool grab(){
+		if(memory == 0){
+			return false;
+		}
+		if(grabbed != 0){
+			grabbed->readers.fetch_sub(1);
+			grabbed = 0;
+		}
+
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHM_TIMEOUT);
+		for(;;){
+			if(header()->published.load() > lastframe){
+				SharedFrameSlot* slot = SharedFrameRing::slot(memory, header()->latest.load());
+				slot->readers.fetch_add(1);
+				uint64_t sequence = slot->sequence.load();
+				if(!(sequence & 1) && sequence / 2 > lastframe){
+					grabbed = slot;
+					lastframe = sequence / 2;
+					return true;
+				}
+				// The writer moved on while we looked, try the new latest frame
+				slot->readers.fetch_sub(1);
+				std::this_thread::yield();
+			} else if(header()->closed.load() != 0){
+				return false;
+			} else if(std::chrono::steady_clock::now() > deadline){
+				Logger::e("The writer of the shared frame ring didn't deliver a frame in time.");
+				return false;
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+	}
+
+	// Wrap the grabbed slot, without copying it. The slot is held until the frame is released.
+	virtual bool retrieve(SourceFrame& frame){
+		if(grabbed == 0){
+			frame.release();
+			return false;
+		}
+
+		frame.image = Mat(grabbed->height, grabbed->width, grabbed->type, SharedFrameRing::data(grabbed), grabbed->step);
+		frame.buffer = std::shared_ptr<void>(grabbed, Release());
+		frame.timestamp = grabbed->timestamp;
+		grabbed = 0;
+		return true;
+	}
+
+private:
+	void* memory;
+	size_t size;
+	uint64_t lastframe; // Number of the last frame taken
+	SharedFrameSlot* grabbed; // Slot held for the grabbed frame, 0 when there is none
+
+	// Deleter of the shared buffer of a frame, gives the slot back to the writer
+	struct Release {
+		void operator()(void* slot){
+			((SharedFrameSlot*)slot)->readers.fetch_sub(1);
+		}
+	};
+
+	SharedFrameRingHeader* header(){
+		return (SharedFrameRingHeader*)memory;
+	}
+
+	// All frames have to be released before the source is closed
+	void detach(){
+		if(memory == 0){
+			return;
+		}
+		if(grabbed != 0){
+			grabbed->readers.fetch_sub(1);
+			grabbed = 0;
+		}
+		munmap(memory, size);
+		memory = 0;
+	}
+};
+
+#endif
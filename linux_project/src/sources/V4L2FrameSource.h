@@ -0,0 +1,255 @@
+#ifndef V4L2FRAMESOURCE_H
+#define V4L2FRAMESOURCE_H
+
+#include "IFrameSource.h"
+#include "../Logger.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <linux/videodev2.h>
+
+const int V4L2_BUFFERS = 4; // Number of buffers shared with the driver
+const int V4L2_TIMEOUT = 2; // Seconds to wait for a frame before the camera is considered gone
+
+// Reads the raw Bayer frames of a camera directly from the V4L2 driver.
+//
+// The driver fills buffers which are mapped in our memory (mmap). A retrieved frame is
+// a Mat which points into such a buffer, so the frame is never copied before the ingest
+// converts it. The buffer is given back to the driver when the last copy of the frame is
+// released. The capture time is the timestamp the driver gave the buffer.
+//
+// The camera has to deliver 8-bit RGGB Bayer frames (V4L2_PIX_FMT_SRGGB8), the format
+// the ingest expects. The size of the frames is the size the camera is set to.
+class V4L2FrameSource : public IFrameSource{
+public:
+	V4L2FrameSource(const std::string& device) : fd(-1), streaming(false), grabbed(-1) {
+		fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+		if(fd < 0){
+			Logger::e("Unable to open the V4L2 device " + device + ": " + strerror(errno));
+			return;
+		}
+		if(!setup(device)){
+			close();
+		}
+	}
+
+	~V4L2FrameSource(){
+		close();
+	}
+
+	virtual bool isOpened(){
+		return fd >= 0;
+	}
+
+	// Take the next filled buffer from the driver
+	virtual bool grab(){
+		if(fd < 0){
+			return false;
+		}
+
+		// A grabbed frame which was never retrieved goes back right away
+		if(grabbed >= 0){
+			queue(grabbed);
+			grabbed = -1;
+		}
+		requeueReleased();
+
+		for(;;){
+			v4l2_buffer buffer = bufferInfo(0);
+			if(xioctl(VIDIOC_DQBUF, &buffer) == 0){
+				grabbed = buffer.index;
+				timestamp = buffer.timestamp.tv_sec * 1000000LL + buffer.timestamp.tv_usec;
+				if(!(buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)){
+					timestamp = steadyMicroseconds(); // Only a monotonic timestamp uses the clock of the steady clock
+				}
+				return true;
+			}
+			if(errno != EAGAIN){
+				Logger::e(std::string("Unable to dequeue a V4L2 buffer: ") + strerror(errno));
+				return false;
+			}
+
+			// Wait until the driver filled a buffer
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(fd, &fds);
+			timeval timeout = { V4L2_TIMEOUT, 0 };
+			int ready = select(fd + 1, &fds, 0, 0, &timeout);
+			if(ready == 0){
+				Logger::e("The V4L2 camera didn't deliver a frame in time.");
+				return false;
+			} else if(ready < 0 && errno != EINTR){
+				return false;
+			}
+		}
+	}
+
+	// Wrap the grabbed buffer, without copying it
+	virtual bool retrieve(SourceFrame& frame){
+		if(grabbed < 0){
+			frame.release();
+			return false;
+		}
+
+		frame.image = Mat(height, width, CV_8UC1, buffers[grabbed].start, bytesperline);
+		frame.buffer = std::shared_ptr<void>(buffers[grabbed].start, Release(this, grabbed));
+		frame.timestamp = timestamp;
+		grabbed = -1;
+		return true;
+	}
+
+private:
+	struct Buffer {
+		void* start;
+		size_t length;
+	};
+
+	// Deleter of the shared buffer of a frame, can be called from any thread
+	struct Release {
+		V4L2FrameSource* source;
+		int index;
+
+		Release(V4L2FrameSource* source, int index) : source(source), index(index) {
+		}
+
+		void operator()(void*){
+			std::lock_guard<std::mutex> lock(source->release_mutex);
+			source->released.push_back(index);
+		}
+	};
+
+	int fd;
+	bool streaming;
+	std::vector<Buffer> buffers;
+	int width, height, bytesperline;
+	int grabbed; // Index of the grabbed buffer, -1 when there is none
+	long long timestamp; // Capture time of the grabbed buffer
+
+	// Buffers of released frames, given back to the driver by the next grab
+	std::mutex release_mutex;
+	std::vector<int> released;
+
+	int xioctl(unsigned long request, void* argument){
+		int result;
+		do {
+			result = ioctl(fd, request, argument);
+		} while(result < 0 && errno == EINTR);
+		return result;
+	}
+
+	v4l2_buffer bufferInfo(int index){
+		v4l2_buffer buffer;
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buffer.memory = V4L2_MEMORY_MMAP;
+		buffer.index = index;
+		return buffer;
+	}
+
+	bool queue(int index){
+		v4l2_buffer buffer = bufferInfo(index);
+		return xioctl(VIDIOC_QBUF, &buffer) == 0;
+	}
+
+	void requeueReleased(){
+		std::vector<int> indices;
+		{
+			std::lock_guard<std::mutex> lock(release_mutex);
+			indices.swap(released);
+		}
+		for(int i = 0; i < indices.size(); i++){
+			queue(indices[i]);
+		}
+	}
+
+	// Set the Bayer format, map the buffers and start streaming
+	bool setup(const std::string& device){
+		v4l2_capability capability;
+		if(xioctl(VIDIOC_QUERYCAP, &capability) < 0 || !(capability.capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(capability.capabilities & V4L2_CAP_STREAMING)){
+			Logger::e(device + " is not a V4L2 capture device with streaming support.");
+			return false;
+		}
+
+		v4l2_format format;
+		memset(&format, 0, sizeof(format));
+		format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		if(xioctl(VIDIOC_G_FMT, &format) < 0){
+			return false;
+		}
+		format.fmt.pix.pixelformat = V4L2_PIX_FMT_SRGGB8;
+		format.fmt.pix.field = V4L2_FIELD_NONE;
+		if(xioctl(VIDIOC_S_FMT, &format) < 0 || format.fmt.pix.pixelformat != V4L2_PIX_FMT_SRGGB8){
+			Logger::e(device + " doesn't deliver 8-bit RGGB Bayer frames.");
+			return false;
+		}
+		width = format.fmt.pix.width;
+		height = format.fmt.pix.height;
+		bytesperline = (format.fmt.pix.bytesperline != 0)? format.fmt.pix.bytesperline : width;
+
+		v4l2_requestbuffers request;
+		memset(&request, 0, sizeof(request));
+		request.count = V4L2_BUFFERS;
+		request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		request.memory = V4L2_MEMORY_MMAP;
+		if(xioctl(VIDIOC_REQBUFS, &request) < 0 || request.count < 2){
+			Logger::e(device + " has not enough memory mapped buffers.");
+			return false;
+		}
+
+		for(int i = 0; i < request.count; i++){
+			v4l2_buffer info = bufferInfo(i);
+			if(xioctl(VIDIOC_QUERYBUF, &info) < 0){
+				return false;
+			}
+			Buffer buffer;
+			buffer.length = info.length;
+			buffer.start = mmap(0, info.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, info.m.offset);
+			if(buffer.start == MAP_FAILED){
+				Logger::e(device + ": unable to map a buffer.");
+				return false;
+			}
+			buffers.push_back(buffer);
+		}
+
+		for(int i = 0; i < buffers.size(); i++){
+			if(!queue(i)){
+				return false;
+			}
+		}
+
+		v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		if(xioctl(VIDIOC_STREAMON, &type) < 0){
+			Logger::e(device + ": unable to start streaming.");
+			return false;
+		}
+		streaming = true;
+		return true;
+	}
+
+	// All frames have to be released before the source is closed
+	void close(){
+		if(fd < 0){
+			return;
+		}
+		if(streaming){
+			v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			xioctl(VIDIOC_STREAMOFF, &type);
+			streaming = false;
+		}
+		for(int i = 0; i < buffers.size(); i++){
+			munmap(buffers[i].start, buffers[i].length);
+		}
+		buffers.clear();
+		::close(fd);
+		fd = -1;
+	}
+};
+
+#endif
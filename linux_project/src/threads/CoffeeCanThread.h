@@ -2,29 +2,37 @@
 #define CoffeeCanThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "opencv/cv.h"
 #include "Helper.h"
+#include "SideCameras.h"
 
 using namespace cv;
 
 namespace CoffeeCanThread{
+	const int PYRAMID_LEVEL = 1; // The edges of the coffee can are still found at half resolution
+
 	// Static helper class to be used during the CoffeeCanThread execution
 	class CoffeeCanThreadHelper{
 	public:
-		// Detect the coffee can inside the current frame
-		static bool hasCoffeeCan(const Mat& frame, Mat &houghImage){
+		// Detect the coffee can inside the current frame. The confidence depends on how far
+		// the position of the coffee can is from the boundaries. The areas are only drawn on
+		// houghImage when debugging.
+		static bool hasCoffeeCan(const Mat& frame, Mat &houghImage, float& confidence, int level, bool debug){
 			bool found = false;
 			Mat cannyImage;
 			Canny(frame, cannyImage, 50, 200, 3);
 			vector<vector<Point> > contours;
-			cvtColor( frame, houghImage, CV_GRAY2BGR );
+			if(debug){
+				cvtColor( frame, houghImage, CV_GRAY2BGR );
+			}
 			// Detect the edges
 			findContours( cannyImage, contours, CV_RETR_EXTERNAL , CV_CHAIN_APPROX_NONE );
 
 			// Save the two biggest area's and the point representing the center of these area's
 			Point p1,p2;
-			// Area's smaller then 10 are ignored
-			double area1=10, area2=10;
+			// Area's smaller then 10 (at full resolution) are ignored
+			double area1=Helper::scaleArea(10, level), area2=area1;
 
 			// Draw each contour and detect it's orientation (horizontal/vertical) and
 			// store the middle of the biggest vertical/horizontal area
@@ -53,7 +61,9 @@ namespace CoffeeCanThread{
 				rect.push_back(Point(maxx, miny));
 				rect.push_back(Point(minx, miny));
 
-				rectangle(houghImage, Point(minx, miny), Point(maxx, maxy), Scalar(0,0,255), 2);
+				if(debug){
+					rectangle(houghImage, Point(minx, miny), Point(maxx, maxy), Scalar(0,0,255), 2);
+				}
 				Moments moment = moments(rect);
 				double area = moment.m00;
 				int posX = moment.m10/area;
@@ -67,8 +77,10 @@ namespace CoffeeCanThread{
 					area2 = area;
 				}
 			}
-			circle(houghImage,  p1, 5, Scalar(255,0,0),2);
-			circle(houghImage,  p2, 5, Scalar(0,255,0),2);
+			if(debug){
+				circle(houghImage,  p1, 5, Scalar(255,0,0),2);
+				circle(houghImage,  p2, 5, Scalar(0,255,0),2);
+			}
 
 			// Detect the position of the coffee can
 			double distanceX;
@@ -84,49 +96,68 @@ namespace CoffeeCanThread{
 				distanceY = p2.y - p1.y;
 
 			// If the coffee can position is between certain boundaries, the coffee can is "inside" of the machine
-			if(p1.x >0 && p2.x >0 && distanceX <200 && distanceX >20 && distanceY < 100){
+			double maxX = Helper::scale(200, level);
+			double minX = Helper::scale(20, level);
+			double maxY = Helper::scale(100, level);
+			if(p1.x >0 && p2.x >0 && distanceX <maxX && distanceX >minX && distanceY < maxY){
 				found = true;
 			}
+
+			if(p1.x <= 0 || p2.x <= 0){
+				confidence = 1.0f; // No edges of the coffee can at all
+			} else {
+				// Distance to the nearest boundary, relative to the size of the allowed range
+				double margin = min(min(distanceX - minX, maxX - distanceX) / ((maxX - minX) / 2), (maxY - distanceY) / maxY);
+				confidence = min(1.0, max(0.2, fabs(margin)));
+			}
 			
 			return found;
 		}
 
-		static bool handleSide(const Mat& frame,  Mat& result_frame){
-			// Convert image to HSB
-			Mat HSVImage = Helper::convertToHSV(frame);
-			// Filter out the detection color for the coffee can
-			Mat detectColor_side = Helper::filterColor(HSVImage,  Scalar(60, 170, 16), Scalar(73, 256, 256));
-
-			// Using median blur, noise inside the frame is reduced and beter results are found
-			medianBlur(detectColor_side, detectColor_side, 5);
-
-			return hasCoffeeCan(detectColor_side, result_frame);
+		static void handleSide(ICoffeeMakerHandler& handler, int camera, SideCameras::SideResult& side, int level, bool debug){
+			// The detection color for the coffee can, filtered with a median blur to reduce the noise
+			Mat detectColor_side = handler.getMask(camera, MASK_GREEN, level);
+			side.value = hasCoffeeCan(detectColor_side, side.debug, side.confidence, level, debug);
 		}
 	};
 
 	// CoffeeCanThread execution
 	void exec(ICoffeeMakerHandler& handler){
-		int count = handler.getSideFrameCount();
-
-		bool hascoffeecan_side1 = false;
-		bool hascoffeecan_side2 = false;
-
-		Mat houghImage_side1;
-		Mat houghImage_side2;
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		bool debug = handler.isDebugging();
 
-		if(count >= 1){
-			hascoffeecan_side1 = CoffeeCanThreadHelper::handleSide(handler.getSideFrame(false), houghImage_side1);
-		}
+		// The second side camera is skipped when the first one is sure the coffee can is there
+		static SideCameras::History history;
+		SideCameras::SideResult sides[2];
+		SideCameras::run(handler, [&](int camera, SideCameras::SideResult& side){
+			CoffeeCanThreadHelper::handleSide(handler, camera, side, level, debug);
+		}, sides, history);
 
-		if(count == 2){
-			hascoffeecan_side2 = CoffeeCanThreadHelper::handleSide(handler.getSideFrame(true), houghImage_side2);
-		}
+		bool hascoffeecan_side1 = sides[0].value;
+		bool hascoffeecan_side2 = sides[1].value;
+		float confidence_side1 = sides[0].confidence;
+		float confidence_side2 = sides[1].confidence;
 
 		// Return result to CoffeeMakerHandler
-		if(count == 1){
-			handler.CoffeeCanThreadEnded(hascoffeecan_side1, houghImage_side1);
+		if(!sides[1].evaluated){
+			DetectorResult output(FIELD_HASCOFFEECAN, hascoffeecan_side1, confidence_side1);
+			output.debug = sides[0].debug;
+			handler.post(output);
 		} else {
-			handler.CoffeeCanThreadEnded(hascoffeecan_side1 ||hascoffeecan_side2, houghImage_side1, houghImage_side2);
+			// When one side sees the coffee can, the most confident side counts. Otherwise both sides
+			// have to be sure it's not there.
+			float confidence;
+			if(hascoffeecan_side1 && hascoffeecan_side2){
+				confidence = max(confidence_side1, confidence_side2);
+			} else if(hascoffeecan_side1 || hascoffeecan_side2){
+				confidence = hascoffeecan_side1? confidence_side1 : confidence_side2;
+			} else {
+				confidence = min(confidence_side1, confidence_side2);
+			}
+			DetectorResult output(FIELD_HASCOFFEECAN, hascoffeecan_side1 || hascoffeecan_side2, confidence);
+			output.debug = sides[0].debug;
+			output.debug_second = sides[1].debug;
+			handler.post(output);
 		}
 	}
 }
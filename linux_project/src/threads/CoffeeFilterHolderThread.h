@@ -2,12 +2,14 @@
 #define CoffeeFilterHolderThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "Helper.h"
 #include "opencv/cv.h"
 
 using namespace cv;
 
 namespace CoffeeFilterHolderThread {
+	const int PYRAMID_LEVEL = 1; // The holder is big enough to be found at half resolution
 
 	// The following variabled are used during execution of the thread, to remember
 	// the last position of the coffee filter holder. When the holder is moved outside
@@ -22,13 +24,15 @@ namespace CoffeeFilterHolderThread {
 	// The execution function of the coffeefilterholder thread
 	void exec(ICoffeeMakerHandler& handler){
 		bool hascoffeefilterholder = false;
+		float confidence = 1.0f; // Only certain when the holder is seen, not when its position is remembered
 
-		Mat frame_top = handler.getTopFrame();
-		CoffeeMakerPosition pos = handler.getPosition();
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		Mat red = handler.getMask(CAMERA_TOP, MASK_RED, level);
+		CoffeeMakerPosition pos = handler.getPosition(level);
 		
 		// Find the coffeefilter holder
 		Mat result;
-		Vec3f holder = Helper::findCoffeeHolder(frame_top,result,pos); 
+		Vec3f holder = Helper::findCoffeeHolder(red,result,pos,level,handler.isDebugging()); 
 
 		// When holder is found, the thread returns true. When not found, the last position of the 
 		// holder is checked to see if the holder is inside of the machine or outside the view of the
@@ -46,12 +50,13 @@ namespace CoffeeFilterHolderThread {
 
 		if(latest_holder_position[1] != 1000){
 			hascoffeefilterholder = true;
+			if(holder[2] <= 0){
+				confidence = 0.5f;
+			}
 			if(counter > 5){		
 				if(!in_position){
-					Mat look_position = Helper::crop(frame_top, Rect(Point(0,pos.getY()-pos.getRatio()*100-100),Point(frame_top.cols,pos.getY()-pos.getRatio()*100)));
-					look_position = Helper::convertToHSV(look_position);
-					look_position = Helper::filterColor(look_position, Scalar(0,208,166),Scalar(98,256,256));
-					medianBlur(look_position,look_position,5);
+					Mat look_position = Helper::crop(red, Rect(Point(0,pos.getY()-pos.getRatio()*100-Helper::scale(100, level)),Point(red.cols,pos.getY()-pos.getRatio()*100)));
+					look_position = look_position.clone(); // findContours changes its input
 
 					vector<vector<Point> > contours;
 					findContours( look_position, contours, CV_RETR_LIST , CV_CHAIN_APPROX_NONE );
@@ -67,7 +72,9 @@ namespace CoffeeFilterHolderThread {
 		}
 
 		// Return result to coffeemaker handler
-		handler.CoffeeFilterHolderThreadEnded(hascoffeefilterholder, result);
+		DetectorResult output(FIELD_COFFEEFILTERHOLDER, hascoffeefilterholder, confidence);
+		output.debug = result;
+		handler.post(output);
 	}
 }
 
@@ -2,24 +2,30 @@
 #define CoffeeFilterThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "Helper.h"
 #include "opencv/cv.h"
 
 using namespace cv;
 
 namespace CoffeeFilterThread {
+	const int PYRAMID_LEVEL = 1; // The holder is big enough to be found at half resolution
 
 	// Execution function for the CoffeeFilterThread, to detect a filter inside the coffeefilter holder
 	void exec(ICoffeeMakerHandler& handler){
 		bool hascoffeefilter = false;
+		float confidence;
 
-		Mat frame_top = handler.getTopFrame();
-		CoffeeMakerPosition pos = handler.getPosition();
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		Mat frame_top = handler.getTopFrame(level);
+		CoffeeMakerPosition pos = handler.getPosition(level);
 
-		Mat result = Helper::validateCoffeeOrFilter(hascoffeefilter,frame_top,false, pos);
+		Mat result = Helper::validateCoffeeOrFilter(hascoffeefilter, confidence, frame_top, handler.getMask(CAMERA_TOP, MASK_RED, level), false, pos, level, handler.isDebugging());
 
 		// Return result to coffeemaker handler
-		handler.CoffeeFilterThreadEnded(hascoffeefilter, result);
+		DetectorResult output(FIELD_HASFILTER, hascoffeefilter, confidence);
+		output.debug = result;
+		handler.post(output);
 	}
 }
 
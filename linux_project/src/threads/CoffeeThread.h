@@ -2,23 +2,29 @@
 #define CoffeeThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "Helper.h"
 
 using namespace cv;
 
 namespace CoffeeThread{
+	const int PYRAMID_LEVEL = 1; // The holder is big enough to be found at half resolution
 
 	// Execution function for the coffee thread. This thread will run only when the coffeefilter holder
 	// is outside of the machine. The thread will return a value indicating if coffee is found inside the holder.
 	void exec(ICoffeeMakerHandler& handler){
 		bool hascoffee = false;
+		float confidence;
 
-		Mat frame_top = handler.getTopFrame();
-		CoffeeMakerPosition pos = handler.getPosition();
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		Mat frame_top = handler.getTopFrame(level);
+		CoffeeMakerPosition pos = handler.getPosition(level);
 
-		Mat result = Helper::validateCoffeeOrFilter(hascoffee,frame_top,true, pos);
+		Mat result = Helper::validateCoffeeOrFilter(hascoffee, confidence, frame_top, handler.getMask(CAMERA_TOP, MASK_RED, level), true, pos, level, handler.isDebugging());
 		// Return result to coffeemaker handler
-		handler.CoffeeThreadEnded(hascoffee, result);
+		DetectorResult output(FIELD_HASCOFFEE, hascoffee, confidence);
+		output.debug = result;
+		handler.post(output);
 	}
 }
 
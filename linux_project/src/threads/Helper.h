@@ -1,6 +1,10 @@
 #ifndef HELPER_H
 #define HELPER_H
 
+#ifdef USE_BITMASK_FILTER
+#include "../BitMask.h"
+#endif
+
 // This class contains the shared helper functions used in several threads
 class Helper{
 public:
@@ -18,42 +22,67 @@ public:
 		return result;
 	}
 
+	// Filter out colors in a specific range and reduce the noise with a median filter of the
+	// given size. With USE_BITMASK_FILTER the median is done on a packed mask (see BitMask),
+	// which only pays off when bitmaskbench measures it faster than medianBlur on the target.
+	static Mat filterColor(const Mat& frame, const Scalar& lowerBound, const Scalar& upperBound, int blursize){
+		Mat result;
+#ifdef USE_BITMASK_FILTER
+		BitMask mask, filtered;
+		mask.inRange(frame, lowerBound, upperBound);
+		mask.median(blursize, filtered);
+		filtered.unpack(result);
+#else
+		inRange(frame, lowerBound, upperBound, result);
+		medianBlur(result, result, blursize);
+#endif
+		return result;
+	}
+
+	// Scale a distance in pixels at full resolution to the given pyramid level
+	static int scale(double pixels, int level){
+		return cvRound(pixels / (1 << level));
+	}
+
+	// Scale an area in pixels at full resolution to the given pyramid level
+	static double scaleArea(double area, int level){
+		return area / (1 << (2 * level));
+	}
+
+	// Returns the size of a median blur kernel at the given pyramid level (odd and at least 3)
+	static int kernel(int size, int level){
+		int scaled = size >> level;
+		return (scaled < 3)? 3 : (scaled | 1);
+	}
+
 	// Crop the frame to a specific area
 	static Mat crop(const Mat & img, const Rect& area){
 		return Mat(img,area);
 	}
 
-	// Detect the coffee filter holder in the specific frame.
-	static Vec3f findCoffeeHolder(const Mat & img, Mat& result, CoffeeMakerPosition & pos){
-		Mat blur;
-
-		// Crop the image 
-		Mat cropped;
-		cropped = Helper::crop(img, Rect(Point(0,0),Point(img.cols,pos.getY()-pos.getRatio()*100)));
-	
-		// Filter image to leave only red
-		Mat filtered = convertToHSV(img); 
-		filtered = Helper::filterColor(filtered, Scalar(0,208,166),Scalar(98,256,256));
-		medianBlur(filtered,filtered,5);
-		
-		// Closing operation to get a nicer circle
-		Mat dilater = getStructuringElement(MORPH_ELLIPSE,Size(10,10));
-		result = Mat::zeros(img.rows,img.cols,CV_8UC3);
+	// Detect the coffee filter holder in the red color mask (MASK_RED) of the top frame, at the given
+	// pyramid level. When debugging the holder is drawn on result, otherwise result stays empty.
+	static Vec3f findCoffeeHolder(const Mat & filtered, Mat& result, CoffeeMakerPosition & pos, int level, bool debug){
+		if(debug){
+			result = Mat::zeros(filtered.rows,filtered.cols,CV_8UC3);
+		}
 
 		Vec3f holder;
 		vector<Vec3f> circles;
-		int min_diameter = 10;
-		int max_diameter = 200;
-		int offset = 200;
+		int min_diameter = scale(10, level);
+		int max_diameter = scale(200, level);
+		int offset = scale(200, level);
 
-		HoughCircles(filtered,circles,CV_HOUGH_GRADIENT,1,500,20,1,min_diameter,max_diameter);
+		HoughCircles(filtered,circles,CV_HOUGH_GRADIENT,1,scale(500, level),20,1,min_diameter,max_diameter);
 
 		// When a circle is found and the diameter comes close to the expected size of the holder,
 		// then the filter holder is found and its position is returned.
 		if(circles.size()==1 && cvRound(circles[0][1]) < offset){	
-			Point c(cvRound(circles[0][0]), cvRound(circles[0][1]));
-			int r = cvRound(circles[0][2]);
-			circle( result, c, r, Scalar(0,0,255), 4, 8, 0 );
+			if(debug){
+				Point c(cvRound(circles[0][0]), cvRound(circles[0][1]));
+				int r = cvRound(circles[0][2]);
+				circle( result, c, r, Scalar(0,0,255), 4, 8, 0 );
+			}
 			holder = circles[0];
 		}
 
@@ -65,7 +94,9 @@ public:
 	// 1: Only the filter holder
 	// 2: Filter holder + filter
 	// 3: Filter holder + filter + coffee
-	static int getTypeFilter(const Mat & gray, Mat & result, const Vec3f & middle, const int fault){
+	// The confidence depends on the distance between the measured intensity and the limits between the types.
+	// The average intensity is only drawn when result is not empty.
+	static int getTypeFilter(const Mat & gray, Mat & result, const Vec3f & middle, const int fault, float & confidence){
 		int count = 0;
 		int intensity = 0;
 
@@ -93,9 +124,13 @@ public:
 		}
 
 		int average = intensity/count;
-		Point c(cvRound(middle[0]), cvRound(middle[1]));
-		int r = 1;
-		circle( result, c, r, Scalar(average,average,average), cvRound(middle[2]*1.8), 8, 0 );
+		if(!result.empty()){
+			Point c(cvRound(middle[0]), cvRound(middle[1]));
+			int r = 1;
+			circle( result, c, r, Scalar(average,average,average), cvRound(middle[2]*1.8), 8, 0 );
+		}
+
+		confidence = min(1.0f, max(0.2f, min(abs(average - 80), abs(average - 140)) / 30.0f));
 
 		if(average < 80)
 			return 1;
@@ -105,21 +140,26 @@ public:
 			return 3;
 	}
 
-	// Helper function to detect coffee or filter inside coffeefilter holder
-	static Mat validateCoffeeOrFilter(bool & gedetecteerd, const Mat & img, bool koffie, CoffeeMakerPosition & pos){
+	// Helper function to detect coffee or filter inside coffeefilter holder. Returns the debug image,
+	// which is empty when not debugging.
+	static Mat validateCoffeeOrFilter(bool & gedetecteerd, float & confidence, const Mat & img, const Mat & red, bool koffie, CoffeeMakerPosition & pos, int level, bool debug){
 		// Find holder
 		Mat result, gray;
 		cvtColor(img,gray,CV_BGR2GRAY);
-		Vec3f holder = Helper::findCoffeeHolder(img,result, pos); 
+		Vec3f holder = Helper::findCoffeeHolder(red,result, pos, level, debug); 
+		int fault = scale(40, level);
+
+		// Without holder the content can't be seen, so the result is uncertain
+		confidence = 0.3f;
 		
 		// If holder found
 		if(holder[2] > 0)
 			if(koffie){
-				if(getTypeFilter(gray,result,holder,40) == 3)
+				if(getTypeFilter(gray,result,holder,fault,confidence) == 3)
 					gedetecteerd = true; 	
 			}
 			else{
-				if(getTypeFilter(gray,result,holder,40) == 2)
+				if(getTypeFilter(gray,result,holder,fault,confidence) == 2)
 					gedetecteerd = true; 	
 			}
 		return result;
@@ -11,14 +11,16 @@
 using namespace cv;
 
 namespace MachineOnThread{
+	const int PYRAMID_LEVEL = 1; // The switch is cropped around the calibrated position, which is scaled with the frame
 
 	// Static helper class used during the execution of the machineon thread. This 
 	// thread detects the status of the on/off switch on the machine.
 	class MachineOnThreadHelper{
 	public:
-		static bool detectButton(const Mat &frame, Mat &outputImage,ICoffeeMakerHandler& handler){
+		// Detect the switch. The confidence increases with the number of contour points found.
+		static bool detectButton(const Mat &frame, Mat &outputImage, float& confidence, ICoffeeMakerHandler& handler, int level, bool debug){
 			// Crop the image to cut out the expected region of the on/off-switch
-			CoffeeMakerPosition pos = handler.getPosition();
+			CoffeeMakerPosition pos = handler.getPosition(level);
 			const float  PI_F=3.14159265358979f;
 			float angleInDegrees = (pos.getAngle() * 180) / PI_F;
 			double w = pos.getWidth()/2;
@@ -50,7 +52,7 @@ namespace MachineOnThread{
 			detectColor = Helper::filterColor(croppedImage, Scalar(60, 100, 50), Scalar(256, 256, 256));
 
 			// Median blur is used to reduce noise to get a better result
-			medianBlur(croppedImage, croppedImage, 5);
+			medianBlur(croppedImage, croppedImage, Helper::kernel(5, level));
 
 			Mat cannyImage;
 			Canny(detectColor, cannyImage, 10, 200, 5);
@@ -58,12 +60,19 @@ namespace MachineOnThread{
 			// Detect contours
 			vector<vector<Point> > contours;
 			findContours( cannyImage, contours, CV_RETR_EXTERNAL , CV_CHAIN_APPROX_NONE );
-			cvtColor(detectColor, outputImage, CV_GRAY2BGR);
+			if(debug){
+				cvtColor(detectColor, outputImage, CV_GRAY2BGR);
+			}
 
 			// Show contours
+			int points = 0;
 			for(int i = 0 ; i < contours.size() ; i++){
-				drawContours( outputImage, contours, 0, Scalar(0, 0, 255), 1);
+				if(debug){
+					drawContours( outputImage, contours, 0, Scalar(0, 0, 255), 1);
+				}
+				points += contours[i].size();
 			}
+			confidence = contours.empty()? 1.0f : min(1.0f, 0.4f + points / (40.0f / (1 << level)));
 
 			if(contours.size() >= 1){
 				return true;
@@ -76,13 +85,17 @@ namespace MachineOnThread{
 
 	// Execution of the MachineOn thread
 	void exec(ICoffeeMakerHandler& handler){	
-		Mat frame_top = handler.getTopFrame();
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		Mat frame_top = handler.getTopFrame(level);
 
 		Mat outputImage;
-		bool machineon = MachineOnThreadHelper::detectButton(frame_top, outputImage, handler);
+		float confidence;
+		bool machineon = MachineOnThreadHelper::detectButton(frame_top, outputImage, confidence, handler, level, handler.isDebugging());
 
 		// Return result to handler
-		handler.MachineOnThreadEnded(machineon, outputImage);
+		DetectorResult output(FIELD_MACHINEON, machineon, confidence);
+		output.debug = outputImage;
+		handler.post(output);
 	}
 }
 
@@ -2,32 +2,36 @@
 #define MachineRunningThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "Helper.h"
 #include "opencv/cv.h"
 
 using namespace cv;
 
 namespace MachineRunningThread{
+	const int PYRAMID_LEVEL = 0; // The light is only a few pixels big, so it needs the full resolution
 
 	// Execution function for the machinerunning thread 
 	void exec(ICoffeeMakerHandler& handler){
 		bool machinerunning = false;
 
-		Mat frame_top = handler.getTopFrame();
+		// With half resolution ingest the full resolution isn't available, the areas are scaled then
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		bool debug = handler.isDebugging();
 
-		// Convert to HSV
-		Mat HSVImage = Helper::convertToHSV(frame_top);
-		// Filter image to maintain specific color range
-		Mat detectColor_top = Helper::filterColor(HSVImage,  Scalar(109, 250, 90), Scalar(119, 256, 256));
-		medianBlur(detectColor_top, detectColor_top, 3);
+		// The color range of the light
+		Mat detectColor_top = handler.getMask(CAMERA_TOP, MASK_BLUE, level);
 
 		Mat houghImage_top;
 		Mat cannyImage;
 		Canny(detectColor_top, cannyImage, 50, 200, 3);
 		vector<vector<Point> > contours;
-		cvtColor( detectColor_top, houghImage_top, CV_GRAY2BGR );
+		if(debug){
+			cvtColor( detectColor_top, houghImage_top, CV_GRAY2BGR );
+		}
 		findContours( cannyImage, contours, CV_RETR_EXTERNAL , CV_CHAIN_APPROX_NONE );
-		int minArea = 40;
+		double maxArea = Helper::scaleArea(40, level);
+		double minArea = maxArea;
 		Point minp;
 		for( int i = 0; i< contours.size(); i++ )
 		 {
@@ -38,14 +42,27 @@ namespace MachineRunningThread{
 			if( area < minArea){
 				minArea = area;
 				Point minp = Point(posX,posY);
-				circle(houghImage_top,  Point(posX,posY), 5, Scalar(255,0,0),2);
+				if(debug){
+					circle(houghImage_top,  Point(posX,posY), 5, Scalar(255,0,0),2);
+				}
 			}
 		 }
-		if (minArea < 40 && minArea > 4)
+		if (minArea < maxArea && minArea > Helper::scaleArea(4, level))
 			machinerunning = true;
+
+		// The light is most certainly found when its area is in the middle of the range. When
+		// there's no blob with the color of the light at all, it's certainly not running.
+		float confidence;
+		if(machinerunning){
+			confidence = max(0.3, 1.0 - fabs(minArea - Helper::scaleArea(22, level)) / Helper::scaleArea(36, level));
+		} else {
+			confidence = contours.empty()? 1.0f : 0.6f;
+		}
 		
 		// Return result to handler class
-		handler.MachineRunningThreadEnded(machinerunning, houghImage_top);
+		DetectorResult output(FIELD_MACHINERUNNING, machinerunning, confidence);
+		output.debug = houghImage_top;
+		handler.post(output);
 	}
 }
 
@@ -2,6 +2,7 @@
 #define ReservoirOpenedThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "opencv/cv.h"
 #include "Helper.h"
 
@@ -9,16 +10,21 @@ using namespace cv;
 
 class CoffeeMakerHandler;
 namespace ReservoirOpenedThread{
+	const int PYRAMID_LEVEL = 1; // The lid is large compared to the pixels lost at half resolution
+
 	// Helper class for the reservoiropened thread
 	class ReservoirOpenedThreadHelper{
 	public:
-		// Detects if the water reservoir is opened or not
-		static bool hasWaterReservoir(const Mat &detectColor, Mat &houghImage){
+		// Detects if the water reservoir is opened or not. The further the area of the lid is from
+		// the limit, the more confident the result. The areas are only drawn when debugging.
+		static bool hasWaterReservoir(const Mat &detectColor, Mat &houghImage, float& confidence, int level, bool debug){
 			bool found = true;
 			Mat cannyImage;
 			Canny(detectColor, cannyImage, 50, 200, 3);
 			vector<vector<Point> > contours;
-			cvtColor( detectColor, houghImage, CV_GRAY2BGR );
+			if(debug){
+				cvtColor( detectColor, houghImage, CV_GRAY2BGR );
+			}
 			findContours( cannyImage, contours, CV_RETR_EXTERNAL , CV_CHAIN_APPROX_NONE );
 			int totalArea = 0;
 			for( int i = 0; i< contours.size(); i++ )
@@ -36,45 +42,46 @@ namespace ReservoirOpenedThread{
 						miny = contours[i][j].y;
 				}
 
-				vector<Point> rect;
-				rect.push_back(Point(minx, maxy));
-				rect.push_back(Point(maxx, maxy));
-				rect.push_back(Point(maxx, miny));
-				rect.push_back(Point(minx, miny));
 				double areaRechthoek = (maxx - minx) * (maxy-miny);
 				totalArea += areaRechthoek;
-				rectangle(houghImage, Point(minx, miny), Point(maxx, maxy), Scalar(0,0,255), 2);
-				Moments moment = moments(rect);
-				double area = moment.m00;
-				int posX = moment.m10/area;
-				int posY = moment.m01/area;
-				circle(houghImage,  Point(posX,posY), 5, Scalar(255,0,0),2);
+				if(debug){
+					vector<Point> rect;
+					rect.push_back(Point(minx, maxy));
+					rect.push_back(Point(maxx, maxy));
+					rect.push_back(Point(maxx, miny));
+					rect.push_back(Point(minx, miny));
+					rectangle(houghImage, Point(minx, miny), Point(maxx, maxy), Scalar(0,0,255), 2);
+					Moments moment = moments(rect);
+					double area = moment.m00;
+					int posX = moment.m10/area;
+					int posY = moment.m01/area;
+					circle(houghImage,  Point(posX,posY), 5, Scalar(255,0,0),2);
+				}
 			}
-			if (totalArea >= 1000) 
+			double limit = Helper::scaleArea(1000, level);
+			if (totalArea >= limit) 
 				found = false;
+			confidence = min(1.0f, max(0.2f, (float)(fabs(totalArea - limit) / limit)));
 			return found;
 		}
 	};
 
 	// Execution function for the reservoiropened thread
 	void exec(ICoffeeMakerHandler& handler){
-		Mat frame_top = handler.getTopFrame();
-		CoffeeMakerPosition pos = handler.getPosition();
-		
-		// Return HSV image
-		Mat HSVImage = Helper::convertToHSV(frame_top);
-
-		// Filter image to maintain only specific color range
-		Mat detectColor_top = Helper::filterColor(HSVImage, Scalar(0,208,166),Scalar(98,256,256));
-		detectColor_top = Helper::crop(detectColor_top, Rect(Point(pos.getX()-80,pos.getY()+50),Point(pos.getX()+50,pos.getY()+100)));
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		CoffeeMakerPosition pos = handler.getPosition(level);
 		
-		medianBlur(detectColor_top, detectColor_top, 5);
+		// Crop the region of the lid out of the color mask, which is shared with the filter holder threads
+		Mat detectColor_top = Helper::crop(handler.getMask(CAMERA_TOP, MASK_RED, level), Rect(Point(pos.getX()-Helper::scale(80, level),pos.getY()+Helper::scale(50, level)),Point(pos.getX()+Helper::scale(50, level),pos.getY()+Helper::scale(100, level))));
 
 		Mat houghImage_top;
-		bool opened = ReservoirOpenedThreadHelper::hasWaterReservoir(detectColor_top, houghImage_top);
+		float confidence;
+		bool opened = ReservoirOpenedThreadHelper::hasWaterReservoir(detectColor_top, houghImage_top, confidence, level, handler.isDebugging());
 		Mat result_top;
 
-		handler.ReservoirOpenedThreadEnded(opened,houghImage_top);
+		DetectorResult output(FIELD_RESERVOIROPEN, opened, confidence);
+		output.debug = houghImage_top;
+		handler.post(output);
 	}
 }
 
@@ -0,0 +1,78 @@
+#ifndef SIDECAMERAS_H
+#define SIDECAMERAS_H
+
+#include "../ICoffeeMakerHandler.h"
+#include "opencv/cv.h"
+#include <thread>
+#include <atomic>
+
+using namespace cv;
+
+// Runs a side detector on the side camera's. The detectors look for something which is
+// there when one of the side camera's sees it, so when the first camera is sure it's there
+// the second camera isn't needed.
+//
+// Whether the second camera is needed is predicted from the previous run of the detector,
+// since the scene rarely changes between two ticks:
+// - After a confident positive first camera, the first camera runs alone and the second
+//   one only runs after it when the first one is now unsure. A skipped camera is treated
+//   as not evaluated.
+// - After an unsure first camera, the second camera runs on its own thread at the same
+//   time as the first one, so two camera's take about as long as one.
+namespace SideCameras{
+	const float SHORTCUT_CONFIDENCE = 0.8f; // Minimal confidence of a positive first camera to skip the second
+
+	// The result of a side detector for one camera
+	struct SideResult {
+		SideResult() : evaluated(false), value(false), confidence(0) {
+		}
+
+		bool evaluated; // False when the camera was skipped, the other fields are then not set
+		bool value;
+		float confidence;
+		Mat debug; // Only made when debugging
+	};
+
+	// What the previous run of a detector needed, one per detector
+	struct History {
+		History() : bothneeded(false) {
+		}
+
+		std::atomic<bool> bothneeded; // The first camera wasn't sure at the previous run
+	};
+
+	// True when the first camera is sure, so the second one isn't needed
+	inline bool sure(const SideResult& first){
+		return first.value && first.confidence >= SHORTCUT_CONFIDENCE;
+	}
+
+	// Run detect(camera, result) on the side camera's. results holds the result of each side camera.
+	template<typename Detect>
+	void run(ICoffeeMakerHandler& handler, Detect detect, SideResult results[2], History& history){
+		if(handler.getSideFrameCount() < 2){
+			detect(CAMERA_SIDE1, results[0]);
+			results[0].evaluated = true;
+			return;
+		}
+
+		if(history.bothneeded){
+			std::thread second([&](){
+				detect(CAMERA_SIDE2, results[1]);
+				results[1].evaluated = true;
+			});
+			detect(CAMERA_SIDE1, results[0]);
+			results[0].evaluated = true;
+			second.join();
+		} else {
+			detect(CAMERA_SIDE1, results[0]);
+			results[0].evaluated = true;
+			if(!sure(results[0])){
+				detect(CAMERA_SIDE2, results[1]);
+				results[1].evaluated = true;
+			}
+		}
+		history.bothneeded = !sure(results[0]);
+	}
+}
+
+#endif
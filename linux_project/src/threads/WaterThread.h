@@ -2,63 +2,73 @@
 #define WaterThread_H
 
 #include "../ICoffeeMakerHandler.h"
+#include "../ColorMasks.h"
 #include "opencv/cv.h"
+#include "SideCameras.h"
 
 using namespace cv;
 
 namespace WaterThread{
+	const int PYRAMID_LEVEL = 1; // Only the presence of water in the top rows is checked
+	const double WATER_FRACTION = 0.02; // Part of the top rows which has to be green to see water
+
 	// Helper class for the water thread
 	class WaterThreadHelper {
 	public:
-		static Mat handleSide(const Mat & side, bool& result){
-			// Convert to HSV
-			Mat HSVImage =  Helper::convertToHSV(side);
-
-			// Filter color
-			Mat detectColor = Helper::filterColor(HSVImage,  Scalar(60, 170, 16), Scalar(73, 256, 256));
-			medianBlur(detectColor, detectColor, 5);
+		// Look for the green of the water in the top 50 rows (at full resolution) of the mask. The
+		// confidence depends on how far the green part of those rows is from WATER_FRACTION.
+		static bool handleSide(const Mat & mask, float& confidence, int level){
+			int rows = min(Helper::scale(50, level), mask.rows);
+			int green = 0;
+			for(int j = 0; j < rows; j++){
+				const uchar* row = mask.ptr<uchar>(j);
+				for(int i = 0; i < mask.cols; i++){
+					green += row[i] != 0;
+				}
+			}
 
-			int j = 0;
-			int i = 0;
-			int offset = 50;
+			double fraction = (rows * mask.cols == 0)? 0.0 : (double)green / (rows * mask.cols);
+			confidence = min(1.0, max(0.2, fabs(fraction - WATER_FRACTION) / WATER_FRACTION));
+			return fraction > WATER_FRACTION;
+		}
 
-			while(!result && i < side.size().width){
-				while(!result && j < offset){
-					Scalar intensity = side.at<uchar>(j,i);
-					if(intensity[0]>0)
-						result = true;
-					j++;
-				}
-				i++;
+		static void handleSide(ICoffeeMakerHandler& handler, int camera, SideCameras::SideResult& side, int level, bool debug){
+			Mat detectColor_side = handler.getMask(camera, MASK_GREEN, level);
+			side.value = handleSide(detectColor_side, side.confidence, level);
+			if(debug){ // The filtered colors are shown when debugging
+				side.debug = detectColor_side;
 			}
-			return detectColor;
 		}
 	};
 
 	// Execution function for the water thread
 	void exec(ICoffeeMakerHandler& handler){
-		int count = handler.getSideFrameCount();
+		int level = handler.getLevel(PYRAMID_LEVEL);
+		bool debug = handler.isDebugging();
 
-		bool haswater_left = false;
-		bool haswater_right = false;
-
-		Mat detectColor_side1;
-		Mat detectColor_side2;
-
-		if(count >= 1){
-			detectColor_side1 = WaterThreadHelper::handleSide(handler.getSideFrame(), haswater_left);
-		}
-
-		if(count == 2){
-			detectColor_side2 = WaterThreadHelper::handleSide(handler.getSideFrame(true), haswater_right);
-		}
+		// Water seen by the first side camera is enough, the second one is then skipped
+		static SideCameras::History history;
+		SideCameras::SideResult sides[2];
+		SideCameras::run(handler, [&](int camera, SideCameras::SideResult& side){
+			WaterThreadHelper::handleSide(handler, camera, side, level, debug);
+		}, sides, history);
 
-		// Return value to the handler class
-		if(count == 1){
-			handler.WaterThreadEnded(haswater_left, detectColor_side1);
+		// Return value to the handler class. Water seen by one side counts with its confidence,
+		// otherwise both sides have to be sure there is none.
+		float confidence;
+		if(!sides[1].evaluated){
+			confidence = sides[0].confidence;
+		} else if(sides[0].value && sides[1].value){
+			confidence = max(sides[0].confidence, sides[1].confidence);
+		} else if(sides[0].value || sides[1].value){
+			confidence = sides[0].value? sides[0].confidence : sides[1].confidence;
 		} else {
-			handler.WaterThreadEnded(haswater_left || haswater_right, detectColor_side1, detectColor_side2);
+			confidence = min(sides[0].confidence, sides[1].confidence);
 		}
+		DetectorResult output(FIELD_HASWATER, sides[0].value || sides[1].value, confidence);
+		output.debug = sides[0].debug;
+		output.debug_second = sides[1].debug;
+		handler.post(output);
 	}
 }
 
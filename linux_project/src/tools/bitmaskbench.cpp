@@ -0,0 +1,76 @@
+#include "opencv/cv.h"
+#include "opencv/highgui.h"
+
+#include "BitMask.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace cv;
+
+typedef chrono::steady_clock Clock;
+
+// The median sizes used by the detectors, at full resolution and the first pyramid levels
+const int KERNELS[] = { 3, 5, 7, 9, 11, 15 };
+const int KERNEL_COUNT = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+static double since(Clock::time_point start, int iterations){
+	return chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count() / 1000.0 / iterations;
+}
+
+// Times the color filter of Helper::filterColor with medianBlur (the default) and with the
+// packed mask (USE_BITMASK_FILTER), so the packed path is only enabled where it's faster.
+int main(int argc, char *argv[]){
+	// The correct usage is: bitmaskbench [image] [iterations]
+	Mat frame;
+	if(argc > 1){
+		Mat image = imread(argv[1]);
+		if(image.empty()){
+			printf("Can't read %s\n", argv[1]);
+			return 1;
+		}
+		cvtColor(image, frame, CV_RGB2HSV);
+	} else {
+		// A frame of the camera size with random colors, about half of the pixels are in range
+		frame.create(480, 640, CV_8UC3);
+		randu(frame, Scalar::all(0), Scalar::all(256));
+	}
+	int iterations = (argc > 2)? atoi(argv[2]) : 100;
+	if(iterations <= 0){
+		iterations = 100;
+	}
+	Scalar lower(0, 0, 0), upper(256, 128, 256);
+
+	printf("%dx%d, %d iterations, milliseconds per filter\n", frame.cols, frame.rows, iterations);
+	printf("kernel  medianBlur  packed  packed without unpack\n");
+	for(int k = 0; k < KERNEL_COUNT; k++){
+		Mat mask;
+		Clock::time_point start = Clock::now();
+		for(int i = 0; i < iterations; i++){
+			inRange(frame, lower, upper, mask);
+			medianBlur(mask, mask, KERNELS[k]);
+		}
+		double opencv = since(start, iterations);
+
+		Mat unpacked;
+		BitMask packed, filtered;
+		start = Clock::now();
+		for(int i = 0; i < iterations; i++){
+			packed.inRange(frame, lower, upper);
+			packed.median(KERNELS[k], filtered);
+			filtered.unpack(unpacked);
+		}
+		double bitmask = since(start, iterations);
+
+		start = Clock::now();
+		for(int i = 0; i < iterations; i++){
+			packed.inRange(frame, lower, upper);
+			packed.median(KERNELS[k], filtered);
+		}
+		double filteronly = since(start, iterations);
+
+		printf("%6d  %10.3f  %6.3f  %21.3f\n", KERNELS[k], opencv, bitmask, filteronly);
+	}
+	return 0;
+}
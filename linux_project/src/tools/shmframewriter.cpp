@@ -0,0 +1,104 @@
+#include "Logger.h"
+#include "opencv/cv.h"
+#include "opencv/highgui.h"
+
+#include "sources/IFrameSource.h"
+#include "sources/SharedFrameRing.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <sstream>
+
+using namespace std;
+using namespace cv;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int){
+	stopping = 1;
+}
+
+// Writes the frames of a video file or a camera into a shared frame ring, so koffiedetection
+// (and other readers) can attach to it with shm:<name>. Used to test the shared frame ring,
+// and to share one camera between several processes.
+int main(int argc, char *argv[]){
+	Logger::setVerbose(true);
+
+	// The correct usage is: shmframewriter [options] name source
+	const char* name = 0;
+	const char* source = 0;
+	int fps = 30;
+	int slots = SHM_RING_SLOTS;
+	bool loop = false;
+	bool validoptions = true;
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if(arg == "--fps" && i + 1 < argc){
+			fps = atoi(argv[++i]);
+		} else if(arg == "--slots" && i + 1 < argc){
+			slots = atoi(argv[++i]);
+		} else if(arg == "--loop"){
+			loop = true;
+		} else if(arg.compare(0, 2, "--") == 0){
+			validoptions = false;
+		} else if(name == 0){
+			name = argv[i];
+		} else if(source == 0){
+			source = argv[i];
+		} else {
+			validoptions = false;
+		}
+	}
+
+	if(!validoptions || source == 0 || fps <= 0 || slots < 2){
+		cout << endl << "!!! Incorrect usage:\n" << "Usage: shmframewriter" << " " << "[options] name source" << endl;
+		cout << "\tname: " << "Name of the shared frame ring, readers use shm:<name>" << endl;
+		cout << "\tsource: " << "The path to a video file or camera" << endl;
+		cout << "\toptions:" << endl;
+		cout << "\t--fps <n>: " << "Frames written per second (default 30)" << endl;
+		cout << "\t--slots <n>: " << "Number of frames in the ring (default " << SHM_RING_SLOTS << ")" << endl;
+		cout << "\t--loop: " << "Start the video file again at the end" << endl;
+
+		return 1;
+	}
+
+	VideoCapture capture(source);
+	if(!capture.isOpened()){
+		Logger::e(string("Unable to open ") + source);
+		Logger::shutdown();
+		return 1;
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	SharedFrameWriter writer(name, slots);
+	long long written = 0;
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	while(!stopping){
+		Mat frame;
+		if(!capture.read(frame) || frame.empty()){
+			if(loop && written > 0){
+				capture.open(source);
+				continue;
+			}
+			break;
+		}
+
+		if(writer.write(frame, steadyMicroseconds())){
+			written++;
+		} else if(written == 0){
+			Logger::e(string("Unable to create the shared frame ring ") + name);
+			break;
+		}
+
+		next += std::chrono::microseconds(1000000 / fps);
+		std::this_thread::sleep_until(next);
+	}
+
+	stringstream message;
+	message << written << " frames written, " << writer.getDropped() << " dropped.";
+	Logger::i(message.str());
+	Logger::shutdown();
+
+	return 0;
+}
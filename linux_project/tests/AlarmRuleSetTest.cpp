@@ -0,0 +1,154 @@
+#include "AlarmRuleSet.h"
+#include <cstdio>
+
+// Checks the parser and the compiled conditions of the alarm rules.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if(!(condition)){ \
+		printf("FAILED line %d: %s\n", __LINE__, #condition); \
+		failures++; \
+	}
+
+const unsigned int ALL_STATES = 1u << FIELD_COUNT;
+
+static bool has(unsigned int state, StatusField field){
+	return (state & fieldBit(field)) != 0;
+}
+
+// Compiles one rule, returns 0 when it's invalid
+static shared_ptr<AlarmRuleSet> compile(const string& text, string& error){
+	shared_ptr<AlarmRuleSet> rules(new AlarmRuleSet());
+	if(!rules->parse(text, error)){
+		return shared_ptr<AlarmRuleSet>();
+	}
+	return rules;
+}
+
+// True when the message of a failed parse contains the text
+static bool fails(const string& text, const string& expected){
+	string error;
+	shared_ptr<AlarmRuleSet> rules = compile(text, error);
+	if(rules){
+		return false;
+	}
+	if(error.find(expected) == string::npos){
+		printf("Unexpected error for '%s': %s\n", text.c_str(), error.c_str());
+		return false;
+	}
+	return true;
+}
+
+// && binds stronger than ||, and ! stronger than both
+static void testPrecedence(){
+	string error;
+	shared_ptr<AlarmRuleSet> rules = compile("reservoiropen || machineon && !machinerunning -> alarm a", error);
+	CHECK(rules && rules->size() == 1);
+	if(!rules){
+		return;
+	}
+	for(unsigned int state = 0; state < ALL_STATES; state++){
+		bool expected = has(state, FIELD_RESERVOIROPEN) || (has(state, FIELD_MACHINEON) && !has(state, FIELD_MACHINERUNNING));
+		CHECK(rules->evaluate(0, state) == expected);
+	}
+}
+
+static void testParentheses(){
+	string error;
+	shared_ptr<AlarmRuleSet> rules = compile(
+		"(reservoiropen || machineon) && machinerunning -> alarm a\n"
+		"!(machineon && !(hascoffee || hasfilter)) -> alarm b\n", error);
+	CHECK(rules && rules->size() == 2);
+	if(!rules){
+		return;
+	}
+	for(unsigned int state = 0; state < ALL_STATES; state++){
+		bool a = (has(state, FIELD_RESERVOIROPEN) || has(state, FIELD_MACHINEON)) && has(state, FIELD_MACHINERUNNING);
+		bool b = !(has(state, FIELD_MACHINEON) && !(has(state, FIELD_HASCOFFEE) || has(state, FIELD_HASFILTER)));
+		CHECK(rules->evaluate(0, state) == a);
+		CHECK(rules->evaluate(1, state) == b);
+	}
+}
+
+// The names, messages and the rules every field is read by
+static void testActions(){
+	string error;
+	shared_ptr<AlarmRuleSet> rules = compile(
+		"# A comment\n"
+		"\n"
+		"machineon && !haswater -> alarm water: No water!\n"
+		"reservoiropen -> alarm\n", error);
+	CHECK(rules && rules->size() == 2);
+	if(!rules){
+		return;
+	}
+	CHECK(rules->rule(0).name == "water");
+	CHECK(rules->rule(0).message == "No water!");
+	CHECK(rules->rule(1).name == "rule2");
+	CHECK(rules->rule(1).message == "reservoiropen");
+
+	CHECK(rules->rule(0).fields == (fieldBit(FIELD_MACHINEON) | fieldBit(FIELD_HASWATER)));
+	CHECK(rules->dependents(FIELD_MACHINEON).size() == 1 && rules->dependents(FIELD_MACHINEON)[0] == 0);
+	CHECK(rules->dependents(FIELD_HASWATER).size() == 1 && rules->dependents(FIELD_HASWATER)[0] == 0);
+	CHECK(rules->dependents(FIELD_RESERVOIROPEN).size() == 1 && rules->dependents(FIELD_RESERVOIROPEN)[0] == 1);
+	CHECK(rules->dependents(FIELD_HASCOFFEE).empty());
+}
+
+// A condition that can never match has no terms and reads no fields
+static void testContradiction(){
+	string error;
+	shared_ptr<AlarmRuleSet> rules = compile("machineon && !machineon -> alarm never", error);
+	CHECK(rules && rules->size() == 1);
+	if(!rules){
+		return;
+	}
+	for(unsigned int state = 0; state < ALL_STATES; state++){
+		CHECK(!rules->evaluate(0, state));
+	}
+	CHECK(rules->dependents(FIELD_MACHINEON).empty());
+}
+
+static void testErrors(){
+	CHECK(fails("coffeepot -> alarm a", "line 1: unknown field 'coffeepot'"));
+	CHECK(fails("machineon -> alarm a\nmachineon && -> alarm b", "line 2: expected a field name"));
+	CHECK(fails("(machineon || hascoffee -> alarm a", "missing ')'"));
+	CHECK(fails("machineon hascoffee -> alarm a", "unexpected 'hascoffee'"));
+	CHECK(fails("machineon alarm a", "missing '->'"));
+	CHECK(fails("machineon -> warn a", "unknown action 'warn a'"));
+	CHECK(fails("machineon -> alarmed", "unknown action"));
+}
+
+// The alarms of the baseline CoffeeMakerStatus::validate, for the built-in rules
+static bool baselineInvalid(unsigned int state){
+	if(!has(state, FIELD_MACHINEON) || !has(state, FIELD_MACHINERUNNING)){
+		return false;
+	}
+	return !has(state, FIELD_HASCOFFEECAN) || !has(state, FIELD_HASFILTER) || !has(state, FIELD_HASCOFFEE)
+		|| has(state, FIELD_RESERVOIROPEN) || has(state, FIELD_COFFEEFILTERHOLDER) || !has(state, FIELD_HASWATER);
+}
+
+static void testDefaults(){
+	shared_ptr<const AlarmRuleSet> rules = AlarmRuleSet::defaults();
+	CHECK(rules->size() == 6);
+	for(unsigned int state = 0; state < ALL_STATES; state++){
+		bool raised = false;
+		for(int i = 0; i < rules->size(); i++){
+			raised = raised || rules->evaluate(i, state);
+		}
+		CHECK(raised == baselineInvalid(state));
+	}
+}
+
+int main(){
+	testPrecedence();
+	testParentheses();
+	testActions();
+	testContradiction();
+	testErrors();
+	testDefaults();
+
+	printf("%s\n", (failures == 0)? "All checks passed" : "Some checks failed");
+	return failures;
+}
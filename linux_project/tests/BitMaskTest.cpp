@@ -0,0 +1,111 @@
+#include "BitMask.h"
+#include <cstdio>
+#include <cstdlib>
+
+// Compares the packed mask with the 8-bit OpenCV functions on random masks.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if(!(condition)){ \
+		printf("FAILED line %d: %s\n", __LINE__, #condition); \
+		failures++; \
+	}
+
+const int SIZES[][2] = { { 1, 1 }, { 7, 9 }, { 48, 64 }, { 61, 130 }, { 120, 160 } }; // Rows and columns
+const int SIZE_COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+// A mask with 0 or 255 pixels, of which about the given percentage is set
+static Mat randomMask(int rows, int cols, int percentage){
+	Mat mask(rows, cols, CV_8UC1);
+	for(int y = 0; y < rows; y++){
+		for(int x = 0; x < cols; x++){
+			mask.at<uchar>(y, x) = (rand() % 100 < percentage)? 255 : 0;
+		}
+	}
+	return mask;
+}
+
+// Number of pixels which differ, only the pixels at least border pixels from the edge are compared
+static int differences(const Mat& a, const Mat& b, int border){
+	int count = 0;
+	for(int y = border; y < a.rows - border; y++){
+		for(int x = border; x < a.cols - border; x++){
+			if(a.at<uchar>(y, x) != b.at<uchar>(y, x)){
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+// Packing and unpacking gives the same mask, also when the width isn't a multiple of 8 or 64
+static void testPackUnpack(){
+	for(int s = 0; s < SIZE_COUNT; s++){
+		Mat mask = randomMask(SIZES[s][0], SIZES[s][1], 50);
+		// Any value which isn't 0 is set
+		mask.at<uchar>(0, 0) = (mask.at<uchar>(0, 0) == 0)? 0 : 1;
+
+		BitMask packed;
+		packed.pack(mask);
+		CHECK(packed.count() == countNonZero(mask));
+
+		Mat unpacked;
+		packed.unpack(unpacked);
+		mask.at<uchar>(0, 0) = (mask.at<uchar>(0, 0) == 0)? 0 : 255;
+		CHECK(differences(mask, unpacked, 0) == 0);
+	}
+}
+
+// The packed inRange sets the same pixels as inRange
+static void testInRange(){
+	for(int s = 0; s < SIZE_COUNT; s++){
+		Mat frame(SIZES[s][0], SIZES[s][1], CV_8UC3);
+		for(int y = 0; y < frame.rows; y++){
+			uchar* p = frame.ptr<uchar>(y);
+			for(int x = 0; x < 3 * frame.cols; x++){
+				p[x] = (uchar)(rand() % 256);
+			}
+		}
+		Scalar lower(40, 60, 80), upper(200, 256, 220);
+
+		Mat expected, unpacked;
+		inRange(frame, lower, upper, expected);
+		BitMask packed;
+		packed.inRange(frame, lower, upper);
+		packed.unpack(unpacked);
+		CHECK(differences(expected, unpacked, 0) == 0);
+	}
+}
+
+// The median is the same as medianBlur, except near the border where medianBlur repeats the
+// border pixels and the packed median counts them as background
+static void testMedian(){
+	const int percentages[] = { 10, 50, 70 };
+	for(int size = 3; size <= BITMASK_MAX_SIZE; size += 2){
+		for(int s = 0; s < SIZE_COUNT; s++){
+			for(int p = 0; p < 3; p++){
+				Mat mask = randomMask(SIZES[s][0], SIZES[s][1], percentages[p]);
+				Mat expected, unpacked;
+				medianBlur(mask, expected, size);
+
+				BitMask packed, filtered;
+				packed.pack(mask);
+				packed.median(size, filtered);
+				filtered.unpack(unpacked);
+				CHECK(differences(expected, unpacked, size / 2) == 0);
+			}
+		}
+	}
+}
+
+int main(){
+	srand(1);
+	testPackUnpack();
+	testInRange();
+	testMedian();
+
+	printf("%s\n", (failures == 0)? "All checks passed" : "Some checks failed");
+	return failures;
+}
@@ -0,0 +1,210 @@
+#include "BrewingCycle.h"
+#include "CoffeeMakerStatus.h"
+#include <vector>
+
+// Drives the status and the brewing cycle through a few sequences, without camera's.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if(!(condition)){ \
+		printf("FAILED line %d: %s\n", __LINE__, #condition); \
+		failures++; \
+	}
+
+const int TICK = 333; // Milliseconds between two updates of the cycle, like an active tick
+
+// Keeps the alarms it receives
+class AlarmSink : public IEventSink{
+public:
+	AlarmSink(vector<string>& raised) : raised(raised) {
+	}
+
+	virtual void publish(const MachineEvent& event){
+		if(event.type == EVENT_ALARM && event.value){
+			raised.push_back(event.name);
+		}
+	}
+
+private:
+	vector<string>& raised;
+};
+
+static bool contains(const vector<string>& names, const string& name){
+	for(int i = 0; i < names.size(); i++){
+		if(names[i] == name){
+			return true;
+		}
+	}
+	return false;
+}
+
+// Give the field the value like a detector does every tick, until the status follows.
+// The cycle is updated after every result, like the handler does at the next tick.
+static void drive(CoffeeMakerStatus& status, BrewingCycle& cycle, StatusField field, bool value){
+	for(int i = 0; i < 100 && status.snapshot().has(field) != value; i++){
+		status.setState(field, value, 1.0f);
+		cycle.update(status.snapshot(), TICK);
+	}
+	cycle.update(status.snapshot(), TICK);
+}
+
+// Give the field the value without updating the cycle, so several fields change before its next update
+static void set(CoffeeMakerStatus& status, StatusField field, bool value){
+	for(int i = 0; i < 100 && status.snapshot().has(field) != value; i++){
+		status.setState(field, value, 1.0f);
+	}
+}
+
+// The machine is turned on while the filter step is skipped, the filter alarm has to fire
+static void testSkippedFilter(){
+	EventStream events;
+	vector<string> raised;
+	events.addSink(new AlarmSink(raised));
+
+	CoffeeMakerStatus status;
+	status.setEventStream(&events);
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+	CHECK(cycle.getStage() == STAGE_IDLE);
+
+	drive(status, cycle, FIELD_RESERVOIROPEN, true);
+	CHECK(cycle.getStage() == STAGE_RESERVOIROPEN);
+	drive(status, cycle, FIELD_HASWATER, true);
+	CHECK(cycle.getStage() == STAGE_FILLING);
+	CHECK(cycle.detectors() & fieldBit(FIELD_MACHINEON));
+
+	drive(status, cycle, FIELD_RESERVOIROPEN, false);
+	CHECK(cycle.getStage() == STAGE_FILTER);
+	drive(status, cycle, FIELD_MACHINEON, true);
+	CHECK(cycle.getStage() == STAGE_BREWING);
+	drive(status, cycle, FIELD_MACHINERUNNING, true);
+	CHECK(cycle.getStage() == STAGE_BREWING);
+
+	CHECK(contains(raised, "filter"));
+	CHECK(!contains(raised, "reservoir"));
+	CHECK(!status.validate());
+}
+
+// The machine is turned on while the reservoir is still open, both alarms have to fire
+static void testOpenReservoir(){
+	EventStream events;
+	vector<string> raised;
+	events.addSink(new AlarmSink(raised));
+
+	CoffeeMakerStatus status;
+	status.setEventStream(&events);
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_RESERVOIROPEN, true);
+	drive(status, cycle, FIELD_MACHINEON, true);
+	CHECK(cycle.getStage() == STAGE_BREWING);
+	drive(status, cycle, FIELD_MACHINERUNNING, true);
+
+	CHECK(contains(raised, "reservoir"));
+	CHECK(contains(raised, "filter"));
+}
+
+// A preparation which is left halfway goes back to idle after the timeout
+static void testAbandonedStage(){
+	CoffeeMakerStatus status;
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_RESERVOIROPEN, true);
+	drive(status, cycle, FIELD_HASWATER, true);
+	CHECK(cycle.getStage() == STAGE_FILLING);
+
+	cycle.update(status.snapshot(), STAGE_TIMEOUT - 2 * TICK);
+	CHECK(cycle.getStage() == STAGE_FILLING);
+	cycle.update(status.snapshot(), 2 * TICK);
+	CHECK(cycle.getStage() == STAGE_IDLE);
+}
+
+// Brewing takes longer than a step of the preparation, but doesn't last forever either
+static void testBrewingTimeout(){
+	CoffeeMakerStatus status;
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_MACHINEON, true);
+	CHECK(cycle.getStage() == STAGE_BREWING);
+	cycle.update(status.snapshot(), STAGE_TIMEOUT * 2);
+	CHECK(cycle.getStage() == STAGE_BREWING);
+	cycle.update(status.snapshot(), BREWING_TIMEOUT);
+	CHECK(cycle.getStage() == STAGE_IDLE);
+}
+
+// The reservoir is filled and closed between two updates, both changes count
+static void testFilledAndClosedTogether(){
+	CoffeeMakerStatus status;
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_RESERVOIROPEN, true);
+	CHECK(cycle.getStage() == STAGE_RESERVOIROPEN);
+	set(status, FIELD_HASWATER, true);
+	set(status, FIELD_RESERVOIROPEN, false);
+	cycle.update(status.snapshot(), TICK);
+	CHECK(cycle.getStage() == STAGE_FILTER);
+}
+
+// The machine stops running and is turned off between two updates
+static void testStoppedAndOffTogether(){
+	CoffeeMakerStatus status;
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_MACHINEON, true);
+	drive(status, cycle, FIELD_MACHINERUNNING, true);
+	CHECK(cycle.getStage() == STAGE_BREWING);
+	set(status, FIELD_MACHINERUNNING, false);
+	set(status, FIELD_MACHINEON, false);
+	cycle.update(status.snapshot(), TICK);
+	CHECK(cycle.getStage() == STAGE_IDLE);
+}
+
+// Turning the machine off ends brewing, without waiting in done
+static void testTurnedOffWhileBrewing(){
+	CoffeeMakerStatus status;
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_MACHINEON, true);
+	drive(status, cycle, FIELD_MACHINERUNNING, true);
+	drive(status, cycle, FIELD_MACHINEON, false);
+	CHECK(cycle.getStage() == STAGE_IDLE);
+}
+
+// A machine which is left on after brewing goes back to idle after the timeout
+static void testDoneTimeout(){
+	CoffeeMakerStatus status;
+	BrewingCycle cycle;
+	cycle.update(status.snapshot(), TICK);
+
+	drive(status, cycle, FIELD_MACHINEON, true);
+	drive(status, cycle, FIELD_MACHINERUNNING, true);
+	drive(status, cycle, FIELD_MACHINERUNNING, false);
+	CHECK(cycle.getStage() == STAGE_DONE);
+	cycle.update(status.snapshot(), BREWING_TIMEOUT - 2 * TICK);
+	CHECK(cycle.getStage() == STAGE_DONE);
+	cycle.update(status.snapshot(), 2 * TICK);
+	CHECK(cycle.getStage() == STAGE_IDLE);
+}
+
+int main(){
+	testSkippedFilter();
+	testOpenReservoir();
+	testAbandonedStage();
+	testBrewingTimeout();
+	testFilledAndClosedTogether();
+	testStoppedAndOffTogether();
+	testTurnedOffWhileBrewing();
+	testDoneTimeout();
+
+	Logger::shutdown();
+	printf("%s\n", (failures == 0)? "All checks passed" : "Some checks failed");
+	return failures;
+}
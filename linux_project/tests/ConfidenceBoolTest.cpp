@@ -0,0 +1,91 @@
+#include "ConfidenceBool.h"
+#include "ThresholdBool.h"
+#include <cstdio>
+#include <cstdlib>
+
+// Compares how fast the confidence bool and the threshold bool flip for the same samples.
+// Returns the number of failed checks.
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	if(!(condition)){ \
+		printf("FAILED line %d: %s\n", __LINE__, #condition); \
+		failures++; \
+	}
+
+const int THRESHOLDS[] = { 3, 5, 6, 10, 18 }; // The thresholds used by the status
+const int THRESHOLD_COUNT = sizeof(THRESHOLDS) / sizeof(THRESHOLDS[0]);
+const int SAMPLES = 200;
+
+// A detector result
+struct Sample {
+	bool value;
+	float confidence;
+};
+
+// Returns the number of samples after which the bool became true, or SAMPLES when it didn't
+template<typename Bool>
+static int flipAfter(Bool b, const Sample* samples){
+	for(int i = 0; i < SAMPLES; i++){
+		b.update(samples[i].value, samples[i].confidence);
+		if(b){
+			return i + 1;
+		}
+	}
+	return SAMPLES;
+}
+
+static float random(float low, float high){
+	return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+// Only doubtful true samples: never faster than the threshold bool
+static void testDoubtfulTrue(){
+	Sample samples[SAMPLES];
+	for(int t = 0; t < THRESHOLD_COUNT; t++){
+		for(int c = 0; c <= 10; c++){
+			for(int i = 0; i < SAMPLES; i++){
+				samples[i].value = true;
+				samples[i].confidence = CONFIDENCE_TRUSTED * c / 10;
+			}
+			CHECK(flipAfter(ConfidenceBool(THRESHOLDS[t], true), samples) >= flipAfter(ThresholdBool(THRESHOLDS[t], true), samples));
+		}
+	}
+}
+
+// Noise: doubtful true samples mixed with false ones. The confidence bool mustn't become
+// true sooner than the threshold bool.
+static void testNoise(){
+	Sample samples[SAMPLES];
+	for(int seed = 1; seed <= 100; seed++){
+		srand(seed);
+		for(int t = 0; t < THRESHOLD_COUNT; t++){
+			for(int i = 0; i < SAMPLES; i++){
+				samples[i].value = rand() % 100 < 60;
+				samples[i].confidence = samples[i].value? random(0.0f, CONFIDENCE_TRUSTED) : random(0.3f, 1.0f);
+			}
+			CHECK(flipAfter(ConfidenceBool(THRESHOLDS[t], true), samples) >= flipAfter(ThresholdBool(THRESHOLDS[t], true), samples));
+		}
+	}
+}
+
+// A detector which is sure still flips the state sooner than the threshold bool
+static void testConfident(){
+	Sample samples[SAMPLES];
+	for(int i = 0; i < SAMPLES; i++){
+		samples[i].value = true;
+		samples[i].confidence = 1.0f;
+	}
+	CHECK(flipAfter(ConfidenceBool(18, true), samples) < flipAfter(ThresholdBool(18, true), samples));
+	CHECK(flipAfter(ConfidenceBool(10, true), samples) < flipAfter(ThresholdBool(10, true), samples));
+}
+
+int main(){
+	testDoubtfulTrue();
+	testNoise();
+	testConfident();
+
+	printf("%s\n", (failures == 0)? "All checks passed" : "Some checks failed");
+	return failures;
+}